@@ -0,0 +1,27 @@
+#include <iostream>
+#include <string>
+#include "log.h"
+#include "ledger.h"
+
+using namespace std;
+
+// Converts store ledgers to the columnar format ahead of time. warehouse
+// does the same on demand whenever a CSV is newer than its .ledger file.
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <store.csv> [<store.csv> ...]" << endl;
+        return 1;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        string csv_filename = argv[i];
+        string output_filename = ledger_cache_path(csv_filename);
+        if (!convert_ledger(csv_filename, output_filename)) {
+            perror("write");
+            log_message(ERROR, "convert", "Failed to write " + output_filename);
+            return 1;
+        }
+        log_message(INFO, "convert", "Converted " + csv_filename + " to " + output_filename);
+    }
+    return 0;
+}
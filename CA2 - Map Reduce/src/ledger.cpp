@@ -0,0 +1,358 @@
+#include "ledger.h"
+#include "log.h"
+#include <charconv>
+#include <cstring>
+#include <cstdio>
+#include <string_view>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Position of the next ',' or '\n' in [p, end), or end.
+static const char *next_delimiter(const char *p, const char *end) {
+#ifdef __SSE2__
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, comma), _mm_cmpeq_epi8(chunk, newline)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && *p != ',' && *p != '\n') {
+        p++;
+    }
+    return p;
+}
+
+static string_view trim(string_view field) {
+    while (!field.empty() && (field.front() == ' ' || field.front() == '\t')) {
+        field.remove_prefix(1);
+    }
+    while (!field.empty() && (field.back() == ' ' || field.back() == '\t' || field.back() == '\r')) {
+        field.remove_suffix(1);
+    }
+    return field;
+}
+
+static bool parse_number(string_view field, float &value) {
+    field = trim(field);
+    if (!field.empty() && field.front() == '+') {
+        field.remove_prefix(1);
+    }
+    from_chars_result result = from_chars(field.data(), field.data() + field.size(), value);
+    return result.ec == errc() && result.ptr == field.data() + field.size();
+}
+
+static RecordType parse_type(string_view field) {
+    if (field.substr(0, 5) == "input") {
+        return RECORD_INPUT;
+    }
+    if (field.substr(0, 6) == "output") {
+        return RECORD_OUTPUT;
+    }
+    return RECORD_OTHER;
+}
+
+static SourceStamp stamp_of(const struct stat &info) {
+    return {(uint64_t)info.st_size, info.st_mtim.tv_sec, info.st_mtim.tv_nsec};
+}
+
+Ledger read_ledger(const string &filename) {
+    Ledger ledger;
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        perror("open");
+        log_message(ERROR, "warehouse", "Failed to open ledger " + filename);
+        exit(1);
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1) {
+        perror("fstat");
+        exit(1);
+    }
+    ledger.source = stamp_of(info);
+    size_t size = info.st_size;
+    if (size == 0) {
+        close(fd);
+        return ledger;
+    }
+    void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror("mmap");
+        log_message(ERROR, "warehouse", "Failed to map ledger " + filename);
+        exit(1);
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    // Names stay views into the mapping until the end, when each distinct
+    // one is copied into ledger.products.
+    unordered_map<string_view, int> product_ids;
+    vector<string_view> names;
+    const char *p = (const char *)mapping;
+    const char *end = p + size;
+    size_t line_number = 0;
+    while (p < end) {
+        line_number++;
+        string_view fields[4];
+        int count = 0;
+        const char *field_end = p;
+        while (true) {
+            field_end = next_delimiter(p, end);
+            if (count < 4) {
+                fields[count] = string_view(p, field_end - p);
+            }
+            count++;
+            p = field_end + 1;
+            if (field_end == end || *field_end == '\n') {
+                break;
+            }
+        }
+
+        if (count == 1 && trim(fields[0]).empty()) {
+            continue;
+        }
+        Record record;
+        if (count < 4 || !parse_number(fields[1], record.price) || !parse_number(fields[2], record.quantity)) {
+            log_message(ERROR, "warehouse", "Malformed line " + to_string(line_number) + " in " + filename);
+            exit(1);
+        }
+        auto found = product_ids.find(fields[0]);
+        if (found == product_ids.end()) {
+            found = product_ids.emplace(fields[0], names.size()).first;
+            names.push_back(fields[0]);
+        }
+        record.product = found->second;
+        record.type = parse_type(fields[3]);
+        ledger.records.push_back(record);
+    }
+
+    for (string_view name : names) {
+        ledger.products.push_back(string(name));
+    }
+    munmap(mapping, size);
+    return ledger;
+}
+
+static const char LEDGER_MAGIC[8] = {'L', 'E', 'D', 'G', 'E', 'R', '1', '\0'};
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+// Byte offset of every section of a columnar ledger.
+struct LedgerLayout {
+    size_t product_offsets;
+    size_t name_offsets;
+    size_t names;
+    size_t product;
+    size_t type;
+    size_t price;
+    size_t quantity;
+    size_t total;
+};
+
+static LedgerLayout ledger_layout(uint64_t products, uint64_t records, uint64_t names_bytes) {
+    LedgerLayout layout;
+    size_t at = align8(sizeof(LedgerFileHeader));
+    layout.product_offsets = at;
+    at = align8(at + (products + 1) * sizeof(uint64_t));
+    layout.name_offsets = at;
+    at = align8(at + (products + 1) * sizeof(uint32_t));
+    layout.names = at;
+    at = align8(at + names_bytes);
+    layout.product = at;
+    at = align8(at + records * sizeof(uint32_t));
+    layout.type = at;
+    at = align8(at + records);
+    layout.price = at;
+    at = align8(at + records * sizeof(float));
+    layout.quantity = at;
+    at = align8(at + records * sizeof(float));
+    layout.total = at;
+    return layout;
+}
+
+string ledger_cache_path(const string &csv_filename) {
+    size_t dot = csv_filename.rfind('.');
+    size_t slash = csv_filename.rfind('/');
+    if (dot == string::npos || (slash != string::npos && dot < slash)) {
+        return csv_filename + ".ledger";
+    }
+    return csv_filename.substr(0, dot) + ".ledger";
+}
+
+vector<char> encode_ledger(const Ledger &ledger) {
+    LedgerFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LEDGER_MAGIC, sizeof(LEDGER_MAGIC));
+    header.source_size = ledger.source.size;
+    header.source_mtime_sec = ledger.source.mtime_sec;
+    header.source_mtime_nsec = ledger.source.mtime_nsec;
+    size_t products = ledger.products.size();
+    size_t records = ledger.records.size();
+    header.product_count = products;
+    header.record_count = records;
+    for (const string &name : ledger.products) {
+        header.names_bytes += name.size();
+    }
+
+    LedgerLayout layout = ledger_layout(products, records, header.names_bytes);
+    vector<char> data(layout.total, 0);
+    memcpy(data.data(), &header, sizeof(header));
+
+    uint32_t *name_offsets = (uint32_t *)(data.data() + layout.name_offsets);
+    char *names = data.data() + layout.names;
+    for (size_t p = 0; p < products; p++) {
+        memcpy(names + name_offsets[p], ledger.products[p].data(), ledger.products[p].size());
+        name_offsets[p + 1] = name_offsets[p] + ledger.products[p].size();
+    }
+
+    // Counting sort by product; stable, so each product keeps ledger order.
+    uint64_t *offsets = (uint64_t *)(data.data() + layout.product_offsets);
+    for (const Record &record : ledger.records) {
+        offsets[record.product + 1]++;
+    }
+    for (size_t p = 0; p < products; p++) {
+        offsets[p + 1] += offsets[p];
+    }
+    vector<uint64_t> next(offsets, offsets + products);
+    uint32_t *product = (uint32_t *)(data.data() + layout.product);
+    uint8_t *type = (uint8_t *)(data.data() + layout.type);
+    float *price = (float *)(data.data() + layout.price);
+    float *quantity = (float *)(data.data() + layout.quantity);
+    for (const Record &record : ledger.records) {
+        uint64_t r = next[record.product]++;
+        product[r] = record.product;
+        type[r] = record.type;
+        price[r] = record.price;
+        quantity[r] = record.quantity;
+    }
+    return data;
+}
+
+static bool write_file(const string &filename, const vector<char> &data) {
+    string temporary = filename + ".tmp." + to_string(getpid());
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t written = write(fd, data.data() + done, data.size() - done);
+        if (written <= 0) {
+            close(fd);
+            unlink(temporary.c_str());
+            return false;
+        }
+        done += written;
+    }
+    close(fd);
+    if (rename(temporary.c_str(), filename.c_str()) == -1) {
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool convert_ledger(const string &csv_filename, const string &output_filename) {
+    Ledger ledger = read_ledger(csv_filename);
+    return write_file(output_filename, encode_ledger(ledger));
+}
+
+static void bind_view(LedgerView &view, const char *base) {
+    view.header = (const LedgerFileHeader *)base;
+    LedgerLayout layout = ledger_layout(view.header->product_count, view.header->record_count, view.header->names_bytes);
+    view.product_offsets = (const uint64_t *)(base + layout.product_offsets);
+    view.name_offsets = (const uint32_t *)(base + layout.name_offsets);
+    view.names = base + layout.names;
+    view.product = (const uint32_t *)(base + layout.product);
+    view.type = (const uint8_t *)(base + layout.type);
+    view.price = (const float *)(base + layout.price);
+    view.quantity = (const float *)(base + layout.quantity);
+}
+
+// Maps `filename` if it is a complete columnar ledger converted from a CSV
+// with exactly `source`'s size and mtime.
+static bool map_cached(const string &filename, const SourceStamp &source, LedgerView &view) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1 || (size_t)info.st_size < sizeof(LedgerFileHeader)) {
+        close(fd);
+        return false;
+    }
+    void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    const LedgerFileHeader *header = (const LedgerFileHeader *)mapping;
+    bool valid = memcmp(header->magic, LEDGER_MAGIC, sizeof(LEDGER_MAGIC)) == 0
+        && header->source_size == source.size
+        && header->source_mtime_sec == source.mtime_sec
+        && header->source_mtime_nsec == source.mtime_nsec
+        && ledger_layout(header->product_count, header->record_count, header->names_bytes).total <= (size_t)info.st_size;
+    if (!valid) {
+        munmap(mapping, info.st_size);
+        return false;
+    }
+    view.mapping = mapping;
+    view.mapping_size = info.st_size;
+    bind_view(view, (const char *)mapping);
+    return true;
+}
+
+void open_ledger(const string &csv_filename, LedgerView &view) {
+    view.mapping = NULL;
+    view.mapping_size = 0;
+    view.buffer.clear();
+
+    struct stat source;
+    if (stat(csv_filename.c_str(), &source) == -1) {
+        perror("stat");
+        log_message(ERROR, "warehouse", "Failed to open ledger " + csv_filename);
+        exit(1);
+    }
+    string cache = ledger_cache_path(csv_filename);
+    if (map_cached(cache, stamp_of(source), view)) {
+        log_message(INFO, "warehouse", "Using converted ledger " + cache);
+        return;
+    }
+
+    log_message(INFO, "warehouse", "Converting " + csv_filename + " to " + cache);
+    Ledger ledger = read_ledger(csv_filename);
+    vector<char> data = encode_ledger(ledger);
+    if (write_file(cache, data) && map_cached(cache, ledger.source, view)) {
+        return;
+    }
+    log_message(INFO, "warehouse", "Could not write " + cache + ", keeping the converted ledger in memory.");
+    view.buffer.swap(data);
+    bind_view(view, view.buffer.data());
+}
+
+void close_ledger(LedgerView &view) {
+    if (view.mapping != NULL) {
+        munmap(view.mapping, view.mapping_size);
+        view.mapping = NULL;
+    }
+    view.buffer.clear();
+}
+
+string_view product_name(const LedgerView &view, int product) {
+    return string_view(view.names + view.name_offsets[product], view.name_offsets[product + 1] - view.name_offsets[product]);
+}
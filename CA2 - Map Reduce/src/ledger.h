@@ -0,0 +1,103 @@
+#ifndef LEDGER_H
+#define LEDGER_H
+
+#include <string>
+#include <vector>
+#include <string_view>
+#include <cstdint>
+using namespace std;
+
+enum RecordType {
+    RECORD_INPUT,
+    RECORD_OUTPUT,
+    RECORD_OTHER,
+};
+
+// One ledger line. Product names are interned: `product` indexes
+// Ledger::products.
+struct Record {
+    int product;
+    float price;
+    float quantity;
+    RecordType type;
+};
+
+// Size and modification time of a ledger CSV.
+struct SourceStamp {
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+};
+
+struct Ledger {
+    vector<Record> records;
+    vector<string> products;
+    SourceStamp source;
+};
+
+// Parses a store ledger ("name,price,quantity,input|output" per line, LF or
+// CRLF endings) straight out of a read-only mapping of the file: fields are
+// string_views into the mapping, numbers go through from_chars and only
+// each distinct product name is copied once. `source` is taken with fstat
+// on the descriptor that is mapped, before any of it is read, so a later
+// change to the file always shows up as a different stamp.
+Ledger read_ledger(const string &filename);
+
+// Columnar binary form of a ledger ("<store>.ledger" next to the CSV).
+// After the header come, each 8-byte aligned:
+//   uint64 product_offsets[product_count + 1]  records of product p are
+//                                               [offsets[p], offsets[p + 1])
+//   uint32 name_offsets[product_count + 1]      product p's name is
+//   char   names[names_bytes]                   names[name_offsets[p] ..]
+//   uint32 product[record_count]
+//   uint8  type[record_count]                   RecordType
+//   float  price[record_count]
+//   float  quantity[record_count]
+// Records are grouped by product, in ledger order within each product,
+// which is all the FIFO lot matching needs. The header records the size
+// and mtime of the CSV it was converted from.
+struct LedgerFileHeader {
+    char magic[8];
+    uint64_t source_size;
+    int64_t source_mtime_sec;
+    int64_t source_mtime_nsec;
+    uint32_t product_count;
+    uint32_t reserved;
+    uint64_t record_count;
+    uint64_t names_bytes;
+};
+
+// Read-only view of a columnar ledger, either mapped from its file or
+// (when the file cannot be written) held in `buffer`.
+struct LedgerView {
+    const LedgerFileHeader *header;
+    const uint64_t *product_offsets;
+    const uint32_t *name_offsets;
+    const char *names;
+    const uint32_t *product;
+    const uint8_t *type;
+    const float *price;
+    const float *quantity;
+    void *mapping;
+    size_t mapping_size;
+    vector<char> buffer;
+};
+
+string ledger_cache_path(const string &csv_filename);
+
+// Encodes a parsed ledger in the columnar layout, stamped with
+// ledger.source.
+vector<char> encode_ledger(const Ledger &ledger);
+
+// Parses the CSV and writes its columnar form to `output_filename` (via a
+// temporary file and rename, so readers never see half a file).
+bool convert_ledger(const string &csv_filename, const string &output_filename);
+
+// Maps the columnar ledger for `csv_filename`, converting the CSV first if
+// the cached file is missing or its recorded size/mtime no longer match.
+void open_ledger(const string &csv_filename, LedgerView &view);
+void close_ledger(LedgerView &view);
+
+string_view product_name(const LedgerView &view, int product);
+
+#endif // LEDGER_H
@@ -11,7 +11,9 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unordered_map>
+#include <chrono>
 #include "log.h"
+#include "protocol.h"
 
 using namespace std;
 
@@ -58,12 +60,12 @@ void create_warehouse_process(const string &filename, int read_fd, int write_fd,
     }
 }
 
-void create_product_process(const string &product, int read_fd, int write_fd, const string &named_pipe, int num_of_processes) {
+void create_product_process(const string &product, int read_fd, int write_fd, const string &named_pipe, int num_of_warehouses) {
     log_message(INFO, "main", "Creating product process for " + product);
     pid_t pid = fork();
     if (pid == 0) {
         // Child process
-        execl("./product", "./product", product.c_str(), to_string(read_fd).c_str(), to_string(write_fd).c_str(), named_pipe.c_str(), to_string(num_of_processes).c_str(), NULL);
+        execl("./product", "./product", product.c_str(), to_string(read_fd).c_str(), to_string(write_fd).c_str(), named_pipe.c_str(), to_string(num_of_warehouses).c_str(), NULL);
         perror("execl");
         exit(1);
     } else if (pid < 0) {
@@ -76,9 +78,147 @@ void create_product_process(const string &product, int read_fd, int write_fd, co
     }
 }
 
+// Parses a line of 1-based product numbers into distinct zero-based IDs.
+// Reports the first token that is not a listed product and returns false.
+bool parse_selection(const string &line, size_t part_count, vector<int32_t> &product_ids) {
+    stringstream ss(line);
+    string pid_str;
+    vector<bool> seen(part_count, false);
+    product_ids.clear();
+    while (ss >> pid_str) {
+        size_t used = 0;
+        int pid = 0;
+        try {
+            pid = stoi(pid_str, &used);
+        } catch (const exception &) {
+        }
+        if (used != pid_str.size() || pid < 1 || pid > (int)part_count) {
+            cerr << "Invalid product number: " << pid_str << endl;
+            return false;
+        }
+        if (!seen[pid - 1]) {
+            seen[pid - 1] = true;
+            product_ids.push_back(pid - 1);
+        }
+    }
+    return true;
+}
+
+// A warehouse started once for --serve. main sends a MESSAGE_QUERY to
+// `query_fd` and reads the MESSAGE_RESULT back from `result_fd`.
+struct WarehouseServer {
+    pid_t pid;
+    int query_fd;
+    int result_fd;
+};
+
+WarehouseServer create_warehouse_server(const string &filename) {
+    log_message(INFO, "main", "Creating warehouse server for " + filename);
+    int query_pipe[2], result_pipe[2];
+    if (pipe(query_pipe) == -1 || pipe(result_pipe) == -1) {
+        perror("pipe");
+        log_message(ERROR, "main", "Failed to create pipes for warehouse " + filename);
+        exit(1);
+    }
+    // main's ends must not leak into the other servers, or a server would
+    // never see end of file on its query pipe.
+    fcntl(query_pipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(result_pipe[0], F_SETFD, FD_CLOEXEC);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Child process
+        execl("./warehouse", "./warehouse", "--serve", filename.c_str(), to_string(query_pipe[0]).c_str(), to_string(result_pipe[1]).c_str(), NULL);
+        perror("execl");
+        exit(1);
+    } else if (pid < 0) {
+        // Error forking
+        perror("fork");
+        log_message(ERROR, "main", "Failed to fork warehouse server for " + filename);
+        exit(1);
+    }
+    log_message(INFO, "main", "Warehouse server created with PID " + to_string(pid));
+    close(query_pipe[0]);
+    close(result_pipe[1]);
+    return {pid, query_pipe[1], result_pipe[0]};
+}
+
+// Starts one warehouse per store and answers queries from stdin until an
+// empty line or end of input. Each store's ledger is opened once, so a
+// query costs a pipe round trip instead of a fork, exec and ledger load
+// per store. main adds up the leftovers itself, which replaces the
+// per-query product processes.
+int serve(const vector<string> &warehouse_files, const vector<string> &parts) {
+    vector<WarehouseServer> servers;
+    for (const auto &filename : warehouse_files) {
+        servers.push_back(create_warehouse_server(filename));
+    }
+
+    string selected_pids;
+    while (true) {
+        cout << "Enter the product numbers to calculate (separated by space, empty line to quit): " << flush;
+        if (!getline(cin, selected_pids)) {
+            break;
+        }
+
+        vector<int32_t> product_ids;
+        if (!parse_selection(selected_pids, parts.size(), product_ids)) {
+            continue;
+        }
+        if (product_ids.empty()) {
+            break;
+        }
+
+        auto start = chrono::steady_clock::now();
+        for (auto &server : servers) {
+            if (!send_query(server.query_fd, product_ids)) {
+                perror("write");
+                log_message(ERROR, "main", "Failed to send query to warehouse server " + to_string(server.pid));
+                exit(1);
+            }
+        }
+
+        float sum = 0;
+        vector<float> left_v(parts.size(), 0), left_q(parts.size(), 0);
+        vector<StockRecord> records;
+        for (auto &server : servers) {
+            if (!receive_records(server.result_fd, MESSAGE_RESULT, records)) {
+                log_message(ERROR, "main", "Failed to read a result from warehouse server " + to_string(server.pid));
+                exit(1);
+            }
+            for (const StockRecord &record : records) {
+                sum += record.profit;
+                left_v[record.product] += record.left_value;
+                left_q[record.product] += record.left_quantity;
+            }
+        }
+        double elapsed_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        log_message(INFO, "main", "Answered query in " + to_string(elapsed_ms) + " ms");
+
+        cout << "---" << endl
+            <<  "The whole profit: " << sum << endl
+            << "---" << endl;
+        for (int pid : product_ids) {
+            cout <<  parts[pid] << endl << "\t"
+                <<  "Total leftover quantity ---> " << to_string(left_q[pid]) << endl << "\t"
+                <<  "Total leftover price ---> " << to_string(left_v[pid])  << endl;
+        }
+    }
+
+    for (auto &server : servers) {
+        close(server.query_fd);
+    }
+    for (auto &server : servers) {
+        waitpid(server.pid, NULL, 0);
+        close(server.result_fd);
+    }
+    log_message(INFO, "main", "All warehouse servers stopped");
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
     if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " <stores_directory>" << endl;
+        cerr << "Usage: " << argv[0] << " <stores_directory> [--serve]" << endl;
         return 1;
     }
 
@@ -94,9 +234,17 @@ int main(int argc, char *argv[]) {
         cout << i + 1 << ". " << parts[i] << endl;
     }
 
+    if (argc > 2 && string(argv[2]) == "--serve") {
+        return serve(warehouse_files, parts);
+    }
+
     string selected_pids;
     cout << "Enter the product numbers to calculate (separated by space): ";
     getline(cin, selected_pids);
+    vector<int32_t> product_ids;
+    if (!parse_selection(selected_pids, parts.size(), product_ids)) {
+        exit(1);
+    }
 
     // Create unnamed pipes for warehouses
     vector<int> warehouse_pipes(warehouse_files.size() * 4);
@@ -134,14 +282,6 @@ int main(int argc, char *argv[]) {
     for (size_t i = 0; i < warehouse_files.size(); ++i) {
         create_warehouse_process(warehouse_files[i], warehouse_pipes[4 * i], warehouse_pipes[4 * i + 1], warehouse_pipes[4 * i + 3], named_pipes);
     }
-    stringstream ss(selected_pids);
-    string pid_str;
-
-    vector<int> product_ids = {};
-    while (ss >> pid_str) {
-        product_ids.push_back(stoi(pid_str) - 1);
-    }
-
     // Create unnamed pipes for products
     vector<int> product_pipes(parts.size() * 2);
     for (size_t i = 0; i < product_ids.size(); ++i) {
@@ -152,43 +292,43 @@ int main(int argc, char *argv[]) {
             exit(1);
         }
         log_message(INFO, "main", "Created pipe for product " + parts[pid]);
-        create_product_process(parts[pid], product_pipes[2 * pid], product_pipes[2 * pid + 1], named_pipes[pid], product_ids.size());
+        create_product_process(parts[pid], product_pipes[2 * pid], product_pipes[2 * pid + 1], named_pipes[pid], warehouse_files.size());
     }
 
     // Send selected product IDs to warehouse processes
     for (size_t i = 0; i < warehouse_files.size(); ++i) {
-        write(warehouse_pipes[4 * i + 1], selected_pids.c_str(), selected_pids.size());
-        fsync(warehouse_pipes[4 * i + 1]); // Ensure data is flushed
+        if (!send_query(warehouse_pipes[4 * i + 1], product_ids)) {
+            perror("write");
+            log_message(ERROR, "main", "Failed to write selected product IDs to warehouse pipe.");
+            exit(1);
+        }
         log_message(INFO, "main", "Wrote selected product IDs to warehouse pipe.");
     }
 
     // Read results from warehouse pipes
-    char buffer_profit[256];
-    vector<float> profits = {};
-    ssize_t n;
+    float sum = 0;
+    vector<StockRecord> records;
     for (size_t i = 0; i < warehouse_files.size(); ++i) {
-        if ((n = read(warehouse_pipes[4 * i + 2], buffer_profit, sizeof(buffer_profit))) > 0) {
-            buffer_profit[n] = '\0';
-            string prof = buffer_profit;
-            profits.push_back(stof(prof));
-            log_message(INFO, "main", "Read result from warehouse pipe: " + string(buffer_profit, n));
+        if (!receive_records(warehouse_pipes[4 * i + 2], MESSAGE_RESULT, records)) {
+            log_message(ERROR, "main", "Failed to read result from warehouse pipe.");
+            exit(1);
         }
+        for (const StockRecord &record : records) {
+            sum += record.profit;
+        }
+        log_message(INFO, "main", "Read result from warehouse pipe for " + to_string(records.size()) + " products");
         close(warehouse_pipes[4 * i + 2]);
     }
 
     // Read data from product pipes
-    char buff_left[256];
-    vector<pair<int,pair<string,string>>> leftover_messages = {};
+    vector<StockRecord> leftovers = {};
     for (size_t i = 0; i < product_ids.size(); ++i) {
-        if ((n = read(product_pipes[2 * product_ids[i]], buff_left, sizeof(buff_left))) > 0) {
-            buff_left[n] = '\0';
-            string first,second;
-            stringstream ss(buff_left);
-            getline(ss, first, ',');
-            getline(ss, second, ',');
-            leftover_messages.push_back({product_ids[i] + 1, {first,second}});
-            log_message(INFO, "main", "Read result from product pipe: " + string(buff_left, n));
+        if (!receive_records(product_pipes[2 * product_ids[i]], MESSAGE_LEFTOVER, records) || records.size() != 1) {
+            log_message(ERROR, "main", "Failed to read result from product pipe for " + parts[product_ids[i]]);
+            exit(1);
         }
+        leftovers.push_back(records[0]);
+        log_message(INFO, "main", "Read result from product pipe for " + parts[product_ids[i]]);
         close(product_pipes[2 * product_ids[i]]);
     }
     // Remove named pipes
@@ -199,17 +339,13 @@ int main(int argc, char *argv[]) {
 
     log_message(INFO, "main", "All processes completed successfully");
 
-    float sum = 0;
-    for (auto p: profits) {
-        sum += p;
-    }
     cout << "---" << endl
         <<  "The whole profit: " << sum << endl
         << "---" << endl;
-    for (auto l: leftover_messages) {
-        cout <<  pid_to_name[l.first] << endl << "\t"
-            <<  "Total leftover quantity ---> " << l.second.second << endl << "\t"
-            <<  "Total leftover price ---> " << l.second.first  << endl;
+    for (auto l: leftovers) {
+        cout <<  pid_to_name[l.product + 1] << endl << "\t"
+            <<  "Total leftover quantity ---> " << to_string(l.left_quantity) << endl << "\t"
+            <<  "Total leftover price ---> " << to_string(l.left_value)  << endl;
     }
 
     return 0;
@@ -0,0 +1,94 @@
+#include "protocol.h"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+using namespace std;
+
+// Upper bound on a payload, so a corrupt header cannot make a reader
+// allocate gigabytes.
+const uint32_t MAX_MESSAGE_LENGTH = 64 << 20;
+
+bool read_full(int fd, void *data, size_t size) {
+    char *bytes = static_cast<char *>(data);
+    while (size > 0) {
+        ssize_t n = read(fd, bytes, size);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool write_full(int fd, const void *data, size_t size) {
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t n = write(fd, bytes, size);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool write_message(int fd, MessageType type, const void *payload, size_t length) {
+    if (length > MAX_MESSAGE_LENGTH) {
+        return false;
+    }
+    MessageHeader header = {type, static_cast<uint32_t>(length)};
+    vector<char> message(sizeof(header) + length);
+    memcpy(message.data(), &header, sizeof(header));
+    if (length > 0) {
+        memcpy(message.data() + sizeof(header), payload, length);
+    }
+    return write_full(fd, message.data(), message.size());
+}
+
+bool read_message(int fd, MessageType type, vector<char> &payload) {
+    MessageHeader header;
+    if (!read_full(fd, &header, sizeof(header))) {
+        return false;
+    }
+    if (header.type != type || header.length > MAX_MESSAGE_LENGTH) {
+        return false;
+    }
+    payload.resize(header.length);
+    return read_full(fd, payload.data(), payload.size());
+}
+
+bool send_query(int fd, const vector<int32_t> &products) {
+    return write_message(fd, MESSAGE_QUERY, products.data(), products.size() * sizeof(int32_t));
+}
+
+bool receive_query(int fd, vector<int32_t> &products) {
+    vector<char> payload;
+    if (!read_message(fd, MESSAGE_QUERY, payload) || payload.size() % sizeof(int32_t) != 0) {
+        return false;
+    }
+    products.resize(payload.size() / sizeof(int32_t));
+    memcpy(products.data(), payload.data(), payload.size());
+    return true;
+}
+
+bool send_records(int fd, MessageType type, const vector<StockRecord> &records) {
+    return write_message(fd, type, records.data(), records.size() * sizeof(StockRecord));
+}
+
+bool receive_records(int fd, MessageType type, vector<StockRecord> &records) {
+    vector<char> payload;
+    if (!read_message(fd, type, payload) || payload.size() % sizeof(StockRecord) != 0) {
+        return false;
+    }
+    records.resize(payload.size() / sizeof(StockRecord));
+    memcpy(records.data(), payload.data(), payload.size());
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+using namespace std;
+
+// Every message on the main/warehouse/product pipes is a MessageHeader
+// followed by `length` bytes of payload:
+//   MESSAGE_QUERY     int32 product[]       main -> warehouse, zero-based
+//                                           product numbers, no repeats
+//   MESSAGE_RESULT    StockRecord[]         warehouse -> main, one per
+//                                           queried product
+//   MESSAGE_LEFTOVER  StockRecord           warehouse -> product (named
+//                                           pipe) and product -> main
+// Fields are native-endian, since both ends are on the same machine.
+enum MessageType : uint32_t {
+    MESSAGE_QUERY = 1,
+    MESSAGE_RESULT = 2,
+    MESSAGE_LEFTOVER = 3,
+};
+
+struct MessageHeader {
+    uint32_t type;
+    uint32_t length;
+};
+
+struct StockRecord {
+    int32_t product;
+    float left_value;
+    float left_quantity;
+    float profit;
+};
+
+static_assert(sizeof(MessageHeader) == 8, "MessageHeader must be packed");
+static_assert(sizeof(StockRecord) == 16, "StockRecord must be packed");
+
+// Loops over short reads/writes and EINTR. read_full is false on error or
+// if the pipe ends before `size` bytes arrive.
+bool read_full(int fd, void *data, size_t size);
+bool write_full(int fd, const void *data, size_t size);
+
+// Sends header and payload with a single write. A message of at most
+// PIPE_BUF bytes (any single StockRecord) is therefore written atomically,
+// even when several warehouses share one named pipe.
+bool write_message(int fd, MessageType type, const void *payload, size_t length);
+// Reads one message into `payload`. False at end of file, on a read error,
+// or if the message is not of the expected `type`.
+bool read_message(int fd, MessageType type, vector<char> &payload);
+
+bool send_query(int fd, const vector<int32_t> &products);
+bool receive_query(int fd, vector<int32_t> &products);
+bool send_records(int fd, MessageType type, const vector<StockRecord> &records);
+bool receive_records(int fd, MessageType type, vector<StockRecord> &records);
+
+#endif // PROTOCOL_H
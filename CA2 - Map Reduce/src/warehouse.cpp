@@ -1,127 +1,163 @@
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <vector>
 #include <string>
 #include <unistd.h>
 #include <fcntl.h>
 #include <unordered_map>
+#include <deque>
+#include <algorithm>
 #include "log.h"
+#include "ledger.h"
+#include "protocol.h"
 
 using namespace std;
 
-struct Record {
-    string name;
+// An input lot that still has stock left.
+struct Lot {
     float price;
     float quantity;
-    string type;
 };
 
-vector<Record> read_csv(const string &filename) {
-    vector<Record> records;
-    ifstream file(filename);
-    string line, word;
+// Running state of one product: its unsold lots, oldest first, and the
+// leftover quantity and value.
+struct ProductStock {
+    deque<Lot> lots;
+    float left_q = 0.0;
+    float left_v = 0.0;
+    float profit = 0.0;
+};
+
+// Sells from the oldest lots first. Each lot is popped once it is used up,
+// so a whole ledger costs O(records) however the sales split the lots. A
+// sale larger than the stock on hand only sells what is there.
+void sell(ProductStock &stock, float price, float quantity) {
+    if (quantity > stock.left_q) {
+        stock.left_q = 0;
+    } else {
+        stock.left_q -= quantity;
+    }
 
-    while (getline(file, line)) {
-        stringstream str(line);
-        Record record;
+    float remaining = quantity;
+    while (remaining > 0 && !stock.lots.empty()) {
+        Lot &lot = stock.lots.front();
+        float used = min(remaining, lot.quantity);
+        stock.profit += (price - lot.price) * used;
+        stock.left_v -= used * lot.price;
+        lot.quantity -= used;
+        remaining -= used;
+        if (lot.quantity <= 0) {
+            stock.lots.pop_front();
+        }
+    }
+}
 
-        getline(str, record.name, ',');
-        getline(str, word, ',');
-        record.price = stof(word);
-        getline(str, word, ',');
-        record.quantity = stof(word);
-        getline(str, record.type, ',');
+// Runs all of one product's records through its FIFO lot queue. The
+// columnar ledger keeps each product's records together, so only that
+// product's slice of the columns is read.
+void replay_product(const LedgerView &ledger, int product, ProductStock &stock) {
+    for (uint64_t r = ledger.product_offsets[product]; r < ledger.product_offsets[product + 1]; r++) {
+        if (ledger.type[r] == RECORD_INPUT) {
+            stock.lots.push_back({ledger.price[r], ledger.quantity[r]});
+            stock.left_q += ledger.quantity[r];
+            stock.left_v += ledger.quantity[r] * ledger.price[r];
+        } else if (ledger.type[r] == RECORD_OUTPUT) {
+            sell(stock, ledger.price[r], ledger.quantity[r]);
+        }
+    }
+}
 
+// Per-product results of one warehouse. A product's records are replayed
+// the first time a query asks for it; a warehouse server then answers
+// later queries for it from `stocks` alone.
+struct StockCache {
+    vector<int> product_of_part;  // part index -> ledger product, or -1
+    vector<int> stock_of;         // ledger product -> index in stocks
+    vector<ProductStock> stocks;
+};
+
+void init_cache(const LedgerView &ledger, const vector<string> &parts, StockCache &cache) {
+    unordered_map<string_view, int> ledger_products;
+    for (uint32_t p = 0; p < ledger.header->product_count; p++) {
+        ledger_products[product_name(ledger, p)] = p;
+    }
+    cache.product_of_part.assign(parts.size(), -1);
+    for (size_t i = 0; i < parts.size(); i++) {
+        auto it = ledger_products.find(parts[i]);
+        if (it != ledger_products.end()) {
+            cache.product_of_part[i] = it->second;
+        }
+    }
+    cache.stock_of.assign(ledger.header->product_count, -1);
+}
+
+// One record per distinct queried product, in query order. Products the
+// store never lists come back as zeros; numbers outside Parts.csv are
+// dropped.
+vector<StockRecord> answer_query(const LedgerView &ledger, const vector<int32_t> &selected_pids, StockCache &cache) {
+    vector<StockRecord> records;
+    vector<bool> seen(cache.product_of_part.size(), false);
+    for (int32_t pid : selected_pids) {
+        if (pid < 0 || pid >= (int)seen.size() || seen[pid]) {
+            continue;
+        }
+        seen[pid] = true;
+
+        StockRecord record = {pid, 0.0, 0.0, 0.0};
+        int product = cache.product_of_part[pid];
+        if (product != -1) {
+            if (cache.stock_of[product] == -1) {
+                cache.stock_of[product] = cache.stocks.size();
+                cache.stocks.push_back(ProductStock());
+                replay_product(ledger, product, cache.stocks.back());
+                deque<Lot>().swap(cache.stocks.back().lots);
+            }
+            const ProductStock &stock = cache.stocks[cache.stock_of[product]];
+            record.left_value = stock.left_v;
+            record.left_quantity = stock.left_q;
+            record.profit = stock.profit;
+        }
         records.push_back(record);
     }
     return records;
 }
 
-void process_warehouse(const string &filename, int read_fd, int write_fd, int result_fd, const unordered_map<int, string> &pid_to_name, const vector<string> &named_pipes) {
-    vector<Record> records = read_csv(filename);
-    char buffer[256];
+void process_warehouse(const string &filename, int read_fd, int write_fd, int result_fd, const vector<string> &parts, const vector<string> &named_pipes) {
+    LedgerView ledger;
+    open_ledger(filename, ledger);
 
     log_message(INFO, "warehouse", "Reading selected PIDs from unnamed pipe (fd: " + to_string(read_fd) + ").");
-    ssize_t n = read(read_fd, buffer, sizeof(buffer));
-    if (n == -1) {
-        perror("read");
-        log_message(ERROR, "warehouse", "Failed to read from the unnamed pipe (fd: " + to_string(read_fd) + ").");
+    vector<int32_t> selected_pids;
+    if (!receive_query(read_fd, selected_pids)) {
+        log_message(ERROR, "warehouse", "Failed to read a query from the unnamed pipe (fd: " + to_string(read_fd) + ").");
         exit(1);
-    } else if (n == 0) {
-        log_message(INFO, "warehouse", "Reached end of pipe, no more data to read.");
     }
+    log_message(INFO, "warehouse", "Read " + to_string(selected_pids.size()) + " selected PIDs from unnamed pipe.");
 
-    buffer[n] = '\0';
-    log_message(INFO, "warehouse", "Successfully read selected PIDs from unnamed pipe: " + string(buffer));
+    StockCache cache;
+    init_cache(ledger, parts, cache);
+    vector<StockRecord> records = answer_query(ledger, selected_pids, cache);
+    close_ledger(ledger);
 
-    stringstream ss(buffer);
-    string pid_str;
-
-    vector<int> selected_pids;
-    while (ss >> pid_str) {
-        selected_pids.push_back(stoi(pid_str) - 1); // Convert to zero-based index
-    }
-
-    // Calculate profits for selected products
-    float left_q = 0.0, left_v = 0.0, profit = 0.0;
-    vector<float> quantities = {};
-    vector<float> prices = {};
-    for (const auto &pid : selected_pids) {
-        left_q = 0;
-        left_v = 0;
-        string product_name = pid_to_name.at(pid + 1);
-
-        for (int i = 0 ; i < records.size() ; i++) {
-            if (records[i].name == product_name) {
-                if (records[i].type.substr(0 , 5) == "input") {
-                    left_q += records[i].quantity;
-                    left_v += records[i].quantity * records[i].price;
-                } else if (records[i].type.substr(0 , 6) == "output") {
-                    if (records[i].quantity > left_q) {
-                        left_q = 0;
-                    }
-                    else {
-                        left_q -= records[i].quantity;
-                    }
-                    for (int k = 0; k < records.size() ; k++) {
-                        if (records[k].type.substr(0 , 5) == "input" && records[k].name == product_name
-                            && records[k].quantity > 0) {
-                                if (records[i].quantity <= records[k].quantity) {
-                                    profit += (records[i].price - records[k].price) * records[i].quantity;
-                                    left_v -= (records[i].quantity * records[k].price);
-                                    records[k].quantity -= records[i].quantity;
-                                    break;
-
-                                }
-                                else {
-                                    profit += ((records[i].price - records[k].price) * records[k].quantity);
-                                    records[k].quantity = 0;
-                                    left_v -= (records[k].quantity * records[k].price);
-                                }
-                        }
-                    }
-                }
-            }
-        }
-        quantities.push_back(left_q);
-        prices.push_back(left_v);
+    if (!send_records(result_fd, MESSAGE_RESULT, records)) {
+        perror("write");
+        log_message(ERROR, "warehouse", "Failed to write to the result pipe (fd: " + to_string(result_fd) + ").");
+        exit(1);
     }
-    
-    string result = to_string(profit) + "\n";
-    write(result_fd, result.c_str(), result.size());
 
-    // Calculate leftovers for each product and send to product processes
+    // Send each product's leftovers to its product process
     log_message(INFO, "warehouse", "Sending leftovers to product processes via named pipes.");
 
-    for (int i = 0; i < selected_pids.size() ; i++) {
-        int fd = open(named_pipes[selected_pids[i]].c_str(), O_WRONLY);
+    for (const StockRecord &record : records) {
+        const string &named_pipe = named_pipes[record.product];
+        int fd = open(named_pipe.c_str(), O_WRONLY);
         if (fd == -1) {
-            log_message(ERROR, "warehouse", "Failed to open the named pipe " + named_pipes[selected_pids[i]]);
+            log_message(ERROR, "warehouse", "Failed to open the named pipe " + named_pipe);
+            exit(1);
+        }
+        if (!send_records(fd, MESSAGE_LEFTOVER, {record})) {
+            log_message(ERROR, "warehouse", "Failed to write to the named pipe " + named_pipe);
             exit(1);
         }
-        string message = to_string(selected_pids[i]) + "," + to_string(prices[i]) + "," + to_string(quantities[i]) + "," + "\n";
-        write(fd, message.c_str(), message.size());
         close(fd);
     }
 
@@ -131,9 +167,41 @@ void process_warehouse(const string &filename, int read_fd, int write_fd, int re
     log_message(INFO, "warehouse", "Warehouse processing completed.");
 }
 
+// Daemon mode: the ledger is opened once and stays mapped, and each
+// product's result is cached after the first query that asks for it, so
+// a repeated query only copies cached numbers. Answers every
+// MESSAGE_QUERY with a MESSAGE_RESULT until main closes the query pipe.
+void serve_warehouse(const string &filename, int read_fd, int result_fd, const vector<string> &parts) {
+    LedgerView ledger;
+    open_ledger(filename, ledger);
+    log_message(INFO, "warehouse", "Serving queries for " + filename);
+
+    StockCache cache;
+    init_cache(ledger, parts, cache);
+    vector<int32_t> selected_pids;
+    while (receive_query(read_fd, selected_pids)) {
+        if (!send_records(result_fd, MESSAGE_RESULT, answer_query(ledger, selected_pids, cache))) {
+            perror("write");
+            log_message(ERROR, "warehouse", "Failed to write to the result pipe (fd: " + to_string(result_fd) + ").");
+            exit(1);
+        }
+    }
+
+    close_ledger(ledger);
+    close(read_fd);
+    close(result_fd);
+    log_message(INFO, "warehouse", "Query pipe closed, warehouse server exiting.");
+}
+
 int main(int argc, char *argv[]) {
+    if (argc == 5 && string(argv[1]) == "--serve") {
+        serve_warehouse(argv[2], stoi(argv[3]), stoi(argv[4]), read_parts(PARTS_DIR));
+        return 0;
+    }
+
     if (argc < 6) {
-        cerr << "Usage: " << argv[0] << " <warehouse_file> <read_fd> <write_fd> <result_fd> <named_pipe_1> [<named_pipe_2> ...]" << endl;
+        cerr << "Usage: " << argv[0] << " <warehouse_file> <read_fd> <write_fd> <result_fd> <named_pipe_1> [<named_pipe_2> ...]" << endl
+             << "       " << argv[0] << " --serve <warehouse_file> <query_fd> <result_fd>" << endl;
         return 1;
     }
 
@@ -147,13 +215,9 @@ int main(int argc, char *argv[]) {
         named_pipes.push_back(argv[i]);
     }
     vector<string> parts = read_parts(PARTS_DIR);
-    unordered_map<int, string> pid_to_name = {};
-    for (int i = 0 ; i < parts.size() ; i++) {
-        pid_to_name[i + 1] = parts[i];
-    }
 
     log_message(INFO, "warehouse", "Starting warehouse processing for " + filename);
-    process_warehouse(filename, read_fd, write_fd, result_fd, pid_to_name, named_pipes);
+    process_warehouse(filename, read_fd, write_fd, result_fd, parts, named_pipes);
 
     return 0;
 }
@@ -0,0 +1,408 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <sndfile.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <sys/stat.h>
+
+using namespace std;
+
+// One configuration to time: a program, the filter it runs and any extra
+// environment or arguments that select a code path. `baseline` is the
+// serial variant that runs the same algorithms (empty if none), and
+// `filters`, when set, limits the variant to those filters.
+struct Variant {
+    std::string name;
+    bool parallel;
+    std::string environment;
+    std::string arguments;
+    std::string baseline;
+    std::vector<std::string> filters;
+};
+
+// The serial build's band-pass and notch scale samples by their index,
+// while the parallel build filters an STFT; only these filters compute
+// the same thing in both programs and so have a speedup over serial.
+const std::vector<std::string> SAME_ALGORITHM_FILTERS = {"fir", "iir"};
+
+struct Measurement {
+    std::string variant;
+    std::string filter;
+    size_t threads;
+    std::vector<double> runsMs;
+    double medianMs;
+    double p95Ms;
+};
+
+struct BenchOptions {
+    size_t frames = 441000;
+    int sampleRate = 44100;
+    int channels = 1;
+    std::string signal = "mix";
+    size_t runs = 5;
+    size_t warmup = 1;
+    std::vector<size_t> threads;
+    std::vector<std::string> variants = {"serial", "parallel", "parallel-scalar", "parallel-fused", "serial-fft", "parallel-fft"};
+    std::vector<std::string> filters = {"bandpass", "notch", "fir", "iir"};
+    std::string serialBinary = "../serial/VoiceFilters.out";
+    std::string parallelBinary = "../parallel/VoiceFilters.out";
+    std::string workDir = "benchWork";
+    std::string csvFile;
+    std::string jsonFile;
+    unsigned seed = 1;
+    // Taps of the low-pass the -fft variants filter with; long enough for
+    // both builds to use FFT overlap-save instead of the direct kernels.
+    size_t fftTaps = 511;
+};
+
+std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+std::string shellQuote(const std::string& text) {
+    std::string quoted = "'";
+    for (char c : text) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "'";
+}
+
+std::string absolutePath(const std::string& path) {
+    char resolved[PATH_MAX];
+    if (realpath(path.c_str(), resolved) == NULL) {
+        std::cerr << "Error: cannot find " << path << " (run make first)" << std::endl;
+        exit(1);
+    }
+    return resolved;
+}
+
+// Synthetic test signal: "sine" is a 1 kHz tone, "noise" is uniform white
+// noise and "mix" adds mains hum, voice-band tones and noise, so every
+// filter has something to remove. Channels get different phases and noise.
+void writeSyntheticSignal(const std::string& file, const BenchOptions& options) {
+    SF_INFO info;
+    info.samplerate = options.sampleRate;
+    info.channels = options.channels;
+    info.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+    SNDFILE* out = sf_open(file.c_str(), SFM_WRITE, &info);
+    if (!out) {
+        std::cerr << "Error opening output file: " << sf_strerror(NULL) << std::endl;
+        exit(1);
+    }
+
+    std::mt19937 generator(options.seed);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+    std::vector<float> samples(options.frames * options.channels);
+    for (size_t n = 0; n < options.frames; ++n) {
+        double t = static_cast<double>(n) / options.sampleRate;
+        for (int c = 0; c < options.channels; ++c) {
+            double phase = 0.7 * c;
+            float value;
+            if (options.signal == "sine") {
+                value = 0.5f * sin(2 * M_PI * 1000.0 * t + phase);
+            } else if (options.signal == "noise") {
+                value = 0.5f * noise(generator);
+            } else {
+                value = 0.2f * sin(2 * M_PI * 50.0 * t + phase) + 0.2f * sin(2 * M_PI * 440.0 * t + phase) +
+                        0.15f * sin(2 * M_PI * 2500.0 * t + phase) + 0.1f * sin(2 * M_PI * 8000.0 * t + phase) +
+                        0.05f * noise(generator);
+            }
+            samples[n * options.channels + c] = value;
+        }
+    }
+
+    if (sf_writef_float(out, samples.data(), options.frames) != (sf_count_t)options.frames) {
+        std::cerr << "Error writing frames to file." << std::endl;
+        exit(1);
+    }
+    sf_close(out);
+}
+
+// Runs the program once and returns the "timing <filter> <us>" value it
+// printed, in milliseconds.
+double runOnce(const std::string& command, const std::string& filter) {
+    FILE* pipe = popen(command.c_str(), "r");
+    if (!pipe) {
+        std::cerr << "Error: cannot run " << command << std::endl;
+        exit(1);
+    }
+
+    double result = -1.0;
+    std::string output;
+    char line[512];
+    while (fgets(line, sizeof(line), pipe)) {
+        output += line;
+        std::istringstream fields(line);
+        std::string tag, name;
+        long long micros;
+        if (fields >> tag >> name >> micros && tag == "timing" && name == filter) {
+            result = micros / 1000.0;
+        }
+    }
+    int status = pclose(pipe);
+    if (status != 0 || result < 0) {
+        std::cerr << "Error: no timing for " << filter << " from: " << command << std::endl << output;
+        exit(1);
+    }
+    return result;
+}
+
+double percentile(std::vector<double> values, double fraction) {
+    std::sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(std::ceil(fraction * values.size()));
+    return values[std::max<size_t>(rank, 1) - 1];
+}
+
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+Measurement measure(const BenchOptions& options, const Variant& variant, const std::string& filter, size_t threads,
+                    const std::string& binary, const std::string& input) {
+    std::string command = "cd " + shellQuote(options.workDir) + " && " + variant.environment + " " + shellQuote(binary) +
+                          " --timings --filter " + filter + " " + variant.arguments;
+    if (variant.parallel) {
+        command += " --threads " + std::to_string(threads);
+    }
+    command += " " + shellQuote(input) + " 2>&1";
+
+    Measurement result;
+    result.variant = variant.name;
+    result.filter = filter;
+    result.threads = threads;
+    for (size_t i = 0; i < options.warmup; ++i) {
+        runOnce(command, filter);
+    }
+    for (size_t i = 0; i < options.runs; ++i) {
+        result.runsMs.push_back(runOnce(command, filter));
+    }
+    result.medianMs = median(result.runsMs);
+    result.p95Ms = percentile(result.runsMs, 0.95);
+    return result;
+}
+
+// Derived figures for one measurement: throughput, speedup over the
+// variant's serial baseline and over the same variant on one thread, and
+// the efficiency (one-thread speedup per thread). Zero where there is no
+// baseline; the reports leave those fields empty.
+struct Derived {
+    double samplesPerSecond;
+    double speedupVsSerial;
+    double speedupVsOneThread;
+    double efficiency;
+};
+
+Derived derive(const Measurement& m, const std::vector<Measurement>& all, size_t samples, const std::map<std::string, Variant>& variants) {
+    Derived d = {0.0, 0.0, 0.0, 0.0};
+    d.samplesPerSecond = m.medianMs > 0 ? samples / (m.medianMs / 1000.0) : 0.0;
+    const std::string& baseline = variants.at(m.variant).baseline;
+    bool comparable = !baseline.empty() &&
+                      std::find(SAME_ALGORITHM_FILTERS.begin(), SAME_ALGORITHM_FILTERS.end(), m.filter) != SAME_ALGORITHM_FILTERS.end();
+    for (const Measurement& other : all) {
+        if (other.filter != m.filter || other.medianMs <= 0) {
+            continue;
+        }
+        if (comparable && other.variant == baseline) {
+            d.speedupVsSerial = other.medianMs / m.medianMs;
+        }
+        if (other.variant == m.variant && other.threads == 1) {
+            d.speedupVsOneThread = other.medianMs / m.medianMs;
+            d.efficiency = d.speedupVsOneThread / m.threads;
+        }
+    }
+    return d;
+}
+
+// A derived figure as text, empty when there is no baseline for it.
+std::string optional(double value, const char* format = "%g") {
+    if (value <= 0) {
+        return "";
+    }
+    char text[32];
+    snprintf(text, sizeof(text), format, value);
+    return text;
+}
+
+void writeCsv(const std::string& file, const std::vector<Measurement>& results, size_t samples, const BenchOptions& options,
+              const std::map<std::string, Variant>& variants) {
+    std::ofstream out(file);
+    out << "variant,filter,threads,frames,channels,runs,median_ms,p95_ms,samples_per_s,speedup_vs_serial,speedup_vs_1_thread,efficiency" << std::endl;
+    for (const Measurement& m : results) {
+        Derived d = derive(m, results, samples, variants);
+        out << m.variant << "," << m.filter << "," << m.threads << "," << options.frames << "," << options.channels << ","
+            << m.runsMs.size() << "," << m.medianMs << "," << m.p95Ms << "," << d.samplesPerSecond << ","
+            << optional(d.speedupVsSerial) << "," << optional(d.speedupVsOneThread) << "," << optional(d.efficiency) << std::endl;
+    }
+}
+
+void writeJson(const std::string& file, const std::vector<Measurement>& results, size_t samples, const BenchOptions& options,
+               const std::map<std::string, Variant>& variants) {
+    std::ofstream out(file);
+    out << "{\n  \"frames\": " << options.frames << ",\n  \"channels\": " << options.channels << ",\n  \"sampleRate\": "
+        << options.sampleRate << ",\n  \"signal\": \"" << options.signal << "\",\n  \"warmup\": " << options.warmup
+        << ",\n  \"fftTaps\": " << options.fftTaps << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Measurement& m = results[i];
+        Derived d = derive(m, results, samples, variants);
+        std::string vsSerial = optional(d.speedupVsSerial), vsOneThread = optional(d.speedupVsOneThread), efficiency = optional(d.efficiency);
+        out << "    {\"variant\": \"" << m.variant << "\", \"filter\": \"" << m.filter << "\", \"threads\": " << m.threads
+            << ", \"runsMs\": [";
+        for (size_t r = 0; r < m.runsMs.size(); ++r) {
+            out << (r ? ", " : "") << m.runsMs[r];
+        }
+        out << "], \"medianMs\": " << m.medianMs << ", \"p95Ms\": " << m.p95Ms << ", \"samplesPerSecond\": " << d.samplesPerSecond
+            << ", \"speedupVsSerial\": " << (vsSerial.empty() ? "null" : vsSerial)
+            << ", \"speedupVsOneThread\": " << (vsOneThread.empty() ? "null" : vsOneThread)
+            << ", \"efficiency\": " << (efficiency.empty() ? "null" : efficiency) << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--frames N] [--rate HZ] [--channels N] [--signal mix|sine|noise] [--seed N]\n"
+              << "       [--runs N] [--warmup N] [--threads 1,2,4,...]\n"
+              << "       [--variants serial,parallel,parallel-scalar,parallel-fused,serial-fft,parallel-fft] [--fft-taps N]\n"
+              << "       [--filters bandpass,notch,fir,iir] [--csv FILE] [--json FILE] [--serial PATH] [--parallel PATH]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--frames" && hasValue) {
+            options.frames = std::max(1L, atol(argv[++i]));
+        } else if (arg == "--rate" && hasValue) {
+            options.sampleRate = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--channels" && hasValue) {
+            options.channels = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--signal" && hasValue) {
+            options.signal = argv[++i];
+        } else if (arg == "--seed" && hasValue) {
+            options.seed = atoi(argv[++i]);
+        } else if (arg == "--runs" && hasValue) {
+            options.runs = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--warmup" && hasValue) {
+            options.warmup = std::max(0, atoi(argv[++i]));
+        } else if (arg == "--threads" && hasValue) {
+            options.threads.clear();
+            for (const std::string& item : splitList(argv[++i])) {
+                options.threads.push_back(std::max(1, atoi(item.c_str())));
+            }
+        } else if (arg == "--variants" && hasValue) {
+            options.variants = splitList(argv[++i]);
+        } else if (arg == "--fft-taps" && hasValue) {
+            options.fftTaps = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--filters" && hasValue) {
+            options.filters = splitList(argv[++i]);
+        } else if (arg == "--csv" && hasValue) {
+            options.csvFile = argv[++i];
+        } else if (arg == "--json" && hasValue) {
+            options.jsonFile = argv[++i];
+        } else if (arg == "--serial" && hasValue) {
+            options.serialBinary = argv[++i];
+        } else if (arg == "--parallel" && hasValue) {
+            options.parallelBinary = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Default sweep: 1, 2, 4, ... up to the number of hardware threads.
+    if (options.threads.empty()) {
+        size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t t = 1; t < hardware; t *= 2) {
+            options.threads.push_back(t);
+        }
+        options.threads.push_back(hardware);
+    }
+
+    std::string fftTaps = "--fir-taps " + std::to_string(options.fftTaps);
+    std::map<std::string, Variant> known = {
+        {"serial", {"serial", false, "", "", "", {}}},
+        {"parallel", {"parallel", true, "", "", "serial", {}}},
+        {"parallel-scalar", {"parallel-scalar", true, "FILTER_SIMD=scalar", "", "serial", {}}},
+        {"parallel-fused", {"parallel-fused", true, "", "--fused normalize,bandpass,notch,fir", "", {}}},
+        {"serial-fft", {"serial-fft", false, "", fftTaps, "", {"fir"}}},
+        {"parallel-fft", {"parallel-fft", true, "", fftTaps, "serial-fft", {"fir"}}},
+    };
+
+    mkdir(options.workDir.c_str(), 0755);
+    std::string input = options.workDir + "/benchInput.wav";
+    writeSyntheticSignal(input, options);
+    input = absolutePath(input);
+    size_t samples = options.frames * options.channels;
+
+    std::vector<Measurement> results;
+    for (const std::string& name : options.variants) {
+        auto found = known.find(name);
+        if (found == known.end()) {
+            std::cerr << "Error: unknown variant '" << name << "'" << std::endl;
+            return 1;
+        }
+        const Variant& variant = found->second;
+        std::string binary = absolutePath(variant.parallel ? options.parallelBinary : options.serialBinary);
+
+        // The fused variant runs its whole chain as one "fused" branch; the
+        // others run whichever of their filters were selected.
+        std::vector<std::string> filters;
+        if (name == "parallel-fused") {
+            filters = {"fused"};
+        } else {
+            for (const std::string& filter : options.filters) {
+                if (variant.filters.empty() || std::find(variant.filters.begin(), variant.filters.end(), filter) != variant.filters.end()) {
+                    filters.push_back(filter);
+                }
+            }
+        }
+        std::vector<size_t> threadCounts = variant.parallel ? options.threads : std::vector<size_t>{1};
+        for (const std::string& filter : filters) {
+            for (size_t threads : threadCounts) {
+                results.push_back(measure(options, variant, filter, threads, binary, input));
+                const Measurement& m = results.back();
+                std::cout << m.variant << " " << m.filter << " threads=" << m.threads << ": median " << m.medianMs
+                          << " ms, p95 " << m.p95Ms << " ms" << std::endl;
+            }
+        }
+    }
+
+    std::cout << std::endl << "variant          filter    threads  median_ms    p95_ms  Msamples/s  vs_serial  vs_1_thread  efficiency" << std::endl;
+    for (const Measurement& m : results) {
+        Derived d = derive(m, results, samples, known);
+        printf("%-16s %-9s %7zu %10.3f %9.3f %11.2f %10s %12s %11s\n", m.variant.c_str(), m.filter.c_str(), m.threads,
+               m.medianMs, m.p95Ms, d.samplesPerSecond / 1e6, optional(d.speedupVsSerial, "%.2f").c_str(),
+               optional(d.speedupVsOneThread, "%.2f").c_str(), optional(d.efficiency, "%.2f").c_str());
+    }
+
+    if (!options.csvFile.empty()) {
+        writeCsv(options.csvFile, results, samples, options, known);
+    }
+    if (!options.jsonFile.empty()) {
+        writeJson(options.jsonFile, results, samples, options, known);
+    }
+    return 0;
+}
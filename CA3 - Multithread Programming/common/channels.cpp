@@ -0,0 +1,113 @@
+#include "channels.hpp"
+
+#include <iostream>
+#include <cstdlib>
+
+using namespace std;
+
+void resizePlanar(PlanarAudio& planar, int channels, size_t frames) {
+    planar.resize(channels);
+    for (auto& channel : planar) {
+        channel.resize(frames);
+    }
+}
+
+void deinterleaveRange(const vector<float>& interleaved, PlanarAudio& planar, size_t firstFrame, size_t lastFrame) {
+    size_t channels = planar.size();
+    for (size_t c = 0; c < channels; ++c) {
+        float* out = planar[c].data();
+        const float* in = interleaved.data() + c;
+        for (size_t f = firstFrame; f < lastFrame; ++f) {
+            out[f] = in[f * channels];
+        }
+    }
+}
+
+void interleaveRange(const PlanarAudio& planar, vector<float>& interleaved, size_t firstFrame, size_t lastFrame) {
+    size_t channels = planar.size();
+    for (size_t c = 0; c < channels; ++c) {
+        const float* in = planar[c].data();
+        float* out = interleaved.data() + c;
+        for (size_t f = firstFrame; f < lastFrame; ++f) {
+            out[f * channels] = in[f];
+        }
+    }
+}
+
+void deinterleave(const vector<float>& interleaved, int channels, PlanarAudio& planar) {
+    size_t frames = interleaved.size() / channels;
+    resizePlanar(planar, channels, frames);
+    deinterleaveRange(interleaved, planar, 0, frames);
+}
+
+void interleave(const PlanarAudio& planar, vector<float>& interleaved) {
+    size_t frames = planar.empty() ? 0 : planar[0].size();
+    interleaved.resize(frames * planar.size());
+    interleaveRange(planar, interleaved, 0, frames);
+}
+
+ChannelSplitStage::ChannelSplitStage(int channels, const ChainBuilder& build)
+    : chains(channels), inputs(channels), outputs(channels) {
+    for (FilterChain& chain : chains) {
+        build(chain);
+    }
+}
+
+void ChannelSplitStage::emit(vector<float>& output) {
+    // Every channel runs the same stages on the same number of samples, so
+    // they release the same number of samples too.
+    interleave(outputs, interleaved);
+    output.insert(output.end(), interleaved.begin(), interleaved.end());
+}
+
+void ChannelSplitStage::process(const vector<float>& input, vector<float>& output) {
+    if (input.size() % chains.size() != 0) {
+        std::cerr << "Error: channel split stage got a partial frame" << std::endl;
+        exit(1);
+    }
+    deinterleave(input, chains.size(), inputs);
+    for (size_t c = 0; c < chains.size(); ++c) {
+        outputs[c].clear();
+        chains[c].process(inputs[c], outputs[c]);
+    }
+    emit(output);
+}
+
+void ChannelSplitStage::flush(vector<float>& output) {
+    for (size_t c = 0; c < chains.size(); ++c) {
+        outputs[c].clear();
+        chains[c].flush(outputs[c]);
+    }
+    emit(output);
+}
+
+void ChannelSplitStage::reset() {
+    for (FilterChain& chain : chains) {
+        chain.reset();
+    }
+}
+
+bool ChannelSplitStage::tileable() const {
+    return chains[0].tileable();
+}
+
+// Per-channel context, scaled to interleaved samples.
+size_t ChannelSplitStage::history() const {
+    return chains[0].history() * chains.size();
+}
+
+size_t ChannelSplitStage::lookahead() const {
+    return chains[0].lookahead() * chains.size();
+}
+
+size_t ChannelSplitStage::alignment() const {
+    return chains[0].alignment() * chains.size();
+}
+
+void addPerChannel(FilterChain& chain, int channels, const ChainBuilder& build) {
+    if (channels <= 1) {
+        build(chain);
+    } else {
+        chain.add(new ChannelSplitStage(channels, build));
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef CHANNELS_HPP
+#define CHANNELS_HPP
+
+#include <vector>
+#include "stream.hpp"
+
+// Planar (structure-of-arrays) audio: one contiguous buffer per channel,
+// instead of the frames * channels interleaving libsndfile reads and writes.
+// The filters treat a buffer as one signal, so multi-channel data has to be
+// split this way first or neighbouring channels get mixed.
+typedef std::vector<std::vector<float>> PlanarAudio;
+
+void resizePlanar(PlanarAudio& planar, int channels, size_t frames);
+
+// Copy frames [firstFrame, lastFrame) between the two layouts. `planar` must
+// already hold enough channels and frames; the ranges let callers split the
+// work.
+void deinterleaveRange(const std::vector<float>& interleaved, PlanarAudio& planar, size_t firstFrame, size_t lastFrame);
+void interleaveRange(const PlanarAudio& planar, std::vector<float>& interleaved, size_t firstFrame, size_t lastFrame);
+
+void deinterleave(const std::vector<float>& interleaved, int channels, PlanarAudio& planar);
+void interleave(const PlanarAudio& planar, std::vector<float>& interleaved);
+
+// Streaming stage that runs its own copy of a chain on every channel of an
+// interleaved stream. Input blocks must hold whole frames, so it belongs at
+// the head of a chain (see addPerChannel).
+class ChannelSplitStage : public FilterStage {
+public:
+    ChannelSplitStage(int channels, const ChainBuilder& build);
+    void process(const std::vector<float>& input, std::vector<float>& output) override;
+    void flush(std::vector<float>& output) override;
+    void reset() override;
+    bool tileable() const override;
+    size_t history() const override;
+    size_t lookahead() const override;
+    size_t alignment() const override;
+
+private:
+    void emit(std::vector<float>& output);
+
+    std::vector<FilterChain> chains;
+    PlanarAudio inputs;
+    PlanarAudio outputs;
+    std::vector<float> interleaved;
+};
+
+// Fills `chain` with the stages from `build`, wrapped in a ChannelSplitStage
+// when there is more than one channel.
+void addPerChannel(FilterChain& chain, int channels, const ChainBuilder& build);
+
+#endif
@@ -0,0 +1,99 @@
+#include "design.hpp"
+
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+using namespace std;
+
+namespace {
+
+// kind, sampleRate, frameSize, first parameter, second parameter
+typedef tuple<int, int, size_t, float, float> DesignKey;
+
+mutex cacheMutex;
+map<DesignKey, SampleTable> cache;
+
+SampleTable cached(const DesignKey& key, const function<SampleTable()>& design) {
+    lock_guard<mutex> lock(cacheMutex);
+    auto found = cache.find(key);
+    if (found != cache.end()) {
+        return found->second;
+    }
+    SampleTable table = design();
+    cache[key] = table;
+    return table;
+}
+
+}
+
+float bandpassResponse(float f, float lowCutoff, float highCutoff) {
+    float deltaF = highCutoff - lowCutoff;
+    if (f < lowCutoff || f > highCutoff) {
+        return 0.0f;
+    }
+    return (f * f) / (f * f + deltaF * deltaF);
+}
+
+float notchResponse(float f, float notchFrequency, int order) {
+    switch (order) {
+    case 1:
+        return notchResponseOrder<1>(f, notchFrequency);
+    case 2:
+        return notchResponseOrder<2>(f, notchFrequency);
+    case 3:
+        return notchResponseOrder<3>(f, notchFrequency);
+    case 4:
+        return notchResponseOrder<4>(f, notchFrequency);
+    default:
+        if (f == 0.0f) {
+            return 0.0f;
+        }
+        return 1.0f / (1.0f + std::pow((notchFrequency / f), 2 * order));
+    }
+}
+
+SampleTable designSpectralGains(int sampleRate, size_t frameSize, const function<float(float)>& response) {
+    shared_ptr<vector<float>> gains = make_shared<vector<float>>(frameSize);
+    for (size_t k = 0; k <= frameSize / 2; ++k) {
+        float f = static_cast<float>(k) * sampleRate / frameSize;
+        (*gains)[k] = response(f) / frameSize;
+        (*gains)[(frameSize - k) % frameSize] = (*gains)[k];
+    }
+    return gains;
+}
+
+SampleTable bandpassGains(int sampleRate, size_t frameSize, float lowCutoff, float highCutoff) {
+    return cached(DesignKey(0, sampleRate, frameSize, lowCutoff, highCutoff), [&] {
+        return designSpectralGains(sampleRate, frameSize, [=](float f) { return bandpassResponse(f, lowCutoff, highCutoff); });
+    });
+}
+
+SampleTable notchGains(int sampleRate, size_t frameSize, float notchFrequency, int order) {
+    return cached(DesignKey(1, sampleRate, frameSize, notchFrequency, order), [&] {
+        return designSpectralGains(sampleRate, frameSize, [=](float f) { return notchResponse(f, notchFrequency, order); });
+    });
+}
+
+SampleTable hannWindow(size_t frameSize) {
+    return cached(DesignKey(2, 0, frameSize, 0.0f, 0.0f), [&] {
+        shared_ptr<vector<float>> window = make_shared<vector<float>>(frameSize);
+        for (size_t i = 0; i < frameSize; ++i) {
+            (*window)[i] = 0.5f - 0.5f * cos(2.0 * M_PI * i / frameSize);
+        }
+        return SampleTable(window);
+    });
+}
+
+vector<float> windowedSincLowpass(size_t taps, float cutoff) {
+    vector<float> coefficients(taps);
+    double center = (taps - 1) / 2.0;
+    for (size_t k = 0; k < taps; ++k) {
+        double t = k - center;
+        double sinc = t == 0.0 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+        double window = taps > 1 ? 0.54 - 0.46 * cos(2.0 * M_PI * k / (taps - 1)) : 1.0;
+        coefficients[k] = sinc * window;
+    }
+    return coefficients;
+}
@@ -0,0 +1,59 @@
+#ifndef DESIGN_HPP
+#define DESIGN_HPP
+
+#include <vector>
+#include <memory>
+#include <functional>
+
+// Frequency responses of the voice filters, and the per-bin tables the
+// STFT filters are built from. Tables are designed once per parameter set
+// and shared, so the filtering loops only multiply.
+
+// Zero outside [lowCutoff, highCutoff], f^2 / (f^2 + deltaF^2) inside.
+float bandpassResponse(float f, float lowCutoff, float highCutoff);
+
+// (notchFrequency / f)^(2 * ORDER) by repeated multiplication; the loop
+// unrolls since ORDER is known at compile time.
+template <int ORDER>
+inline float notchPower(float ratio) {
+    float squared = ratio * ratio;
+    float power = squared;
+    for (int i = 1; i < ORDER; ++i) {
+        power *= squared;
+    }
+    return power;
+}
+
+// 1 / (1 + (f0 / f)^(2 * ORDER)), with its limit of zero at DC instead of
+// a division by zero.
+template <int ORDER>
+inline float notchResponseOrder(float f, float notchFrequency) {
+    if (f == 0.0f) {
+        return 0.0f;
+    }
+    return 1.0f / (1.0f + notchPower<ORDER>(notchFrequency / f));
+}
+
+// Any order: orders 1-4 use the specialised form, others std::pow.
+float notchResponse(float f, float notchFrequency, int order);
+
+typedef std::shared_ptr<const std::vector<float>> SampleTable;
+
+// Per-bin gains of an STFT filter: response(k * sampleRate / frameSize)
+// for bins 0..frameSize/2, mirrored for the negative frequencies, with the
+// inverse transform's 1/frameSize folded in.
+SampleTable designSpectralGains(int sampleRate, size_t frameSize, const std::function<float(float)>& response);
+
+// Cached designs, keyed on every parameter. Safe to call from several
+// threads; the tables are never modified after they are built.
+SampleTable bandpassGains(int sampleRate, size_t frameSize, float lowCutoff, float highCutoff);
+SampleTable notchGains(int sampleRate, size_t frameSize, float notchFrequency, int order);
+
+// Periodic Hann window of `frameSize` samples (cached).
+SampleTable hannWindow(size_t frameSize);
+
+// Hamming-windowed sinc low-pass with `taps` coefficients and cutoff given
+// as a fraction of the sample rate.
+std::vector<float> windowedSincLowpass(size_t taps, float cutoff);
+
+#endif
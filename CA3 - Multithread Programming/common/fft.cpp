@@ -0,0 +1,149 @@
+#include "fft.hpp"
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+size_t nextPowerOfTwo(size_t value) {
+    size_t power = 1;
+    while (power < value) {
+        power <<= 1;
+    }
+    return power;
+}
+
+FFTPlan::FFTPlan(size_t size) : n(size), bitReverse(size), twiddles(size > 1 ? size - 1 : 0) {
+    if (n == 0 || (n & (n - 1)) != 0) {
+        std::cerr << "FFT size must be a power of two: " << n << std::endl;
+        exit(1);
+    }
+
+    size_t bits = 0;
+    while ((size_t(1) << bits) < n) {
+        ++bits;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        size_t reversed = 0;
+        for (size_t b = 0; b < bits; ++b) {
+            if (i & (size_t(1) << b)) {
+                reversed |= size_t(1) << (bits - 1 - b);
+            }
+        }
+        bitReverse[i] = reversed;
+    }
+
+    for (size_t length = 2; length <= n; length <<= 1) {
+        for (size_t k = 0; k < length / 2; ++k) {
+            double angle = -2.0 * M_PI * k / length;
+            twiddles[length / 2 - 1 + k] = complex<float>(cos(angle), sin(angle));
+        }
+    }
+}
+
+void FFTPlan::forward(vector<complex<float>>& data) const {
+    transform(data, false);
+}
+
+void FFTPlan::inverse(vector<complex<float>>& data) const {
+    transform(data, true);
+    float scale = 1.0f / n;
+    for (auto& value : data) {
+        value *= scale;
+    }
+}
+
+void FFTPlan::transform(vector<complex<float>>& data, bool inverse) const {
+    data.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (i < bitReverse[i]) {
+            swap(data[i], data[bitReverse[i]]);
+        }
+    }
+
+    // Butterflies work on the interleaved floats directly; std::complex's
+    // operator* checks for NaN/inf and is several times slower without
+    // -ffast-math, and the plain loop lets the compiler vectorise it.
+    float* values = reinterpret_cast<float*>(data.data());
+    const float* factors = reinterpret_cast<const float*>(twiddles.data());
+    float sign = inverse ? -1.0f : 1.0f;
+    for (size_t length = 2; length <= n; length <<= 1) {
+        size_t half = length / 2;
+        const float* stage = factors + 2 * (half - 1);
+        for (size_t start = 0; start < n; start += length) {
+            float* even = values + 2 * start;
+            float* odd = values + 2 * (start + half);
+            for (size_t k = 0; k < half; ++k) {
+                float wr = stage[2 * k];
+                float wi = sign * stage[2 * k + 1];
+                float tr = odd[2 * k] * wr - odd[2 * k + 1] * wi;
+                float ti = odd[2 * k] * wi + odd[2 * k + 1] * wr;
+                odd[2 * k] = even[2 * k] - tr;
+                odd[2 * k + 1] = even[2 * k + 1] - ti;
+                even[2 * k] += tr;
+                even[2 * k + 1] += ti;
+            }
+        }
+    }
+}
+
+OverlapSaveConvolver::OverlapSaveConvolver(const vector<float>& coefficients)
+    : taps(coefficients.size()),
+      step(0),
+      plan(max(nextPowerOfTwo(8 * coefficients.size()), size_t(1024))) {
+    step = plan.size() - taps + 1;
+
+    // The inverse transform's 1/N is folded into the filter spectrum.
+    spectrum.assign(plan.size(), complex<float>(0.0f, 0.0f));
+    for (size_t k = 0; k < taps; ++k) {
+        spectrum[k] = coefficients[k] / plan.size();
+    }
+    plan.forward(spectrum);
+}
+
+void OverlapSaveConvolver::convolveBlock(const vector<float>& input, size_t outStart, size_t outEnd, float* output, vector<complex<float>>& scratch) const {
+    size_t halo = taps - 1;
+    size_t fftSize = plan.size();
+    size_t size = input.size();
+    scratch.assign(fftSize, complex<float>(0.0f, 0.0f));
+
+    // The real part holds input[outStart - halo + i] and the imaginary part
+    // input[outStart + step - halo + i]; only samples inside the signal are
+    // copied, the rest stays zero.
+    for (size_t part = 0; part < 2; ++part) {
+        size_t origin = outStart + part * step;
+        if (origin >= outEnd) {
+            break;
+        }
+        size_t first = origin < halo ? halo - origin : 0;
+        size_t last = min(fftSize, size + halo - origin);
+        for (size_t i = first; i < last; ++i) {
+            if (part == 0) {
+                scratch[i].real(input[origin - halo + i]);
+            } else {
+                scratch[i].imag(input[origin - halo + i]);
+            }
+        }
+    }
+
+    plan.transform(scratch, false);
+    for (size_t i = 0; i < fftSize; ++i) {
+        float xr = scratch[i].real();
+        float xi = scratch[i].imag();
+        float hr = spectrum[i].real();
+        float hi = spectrum[i].imag();
+        scratch[i] = complex<float>(xr * hr - xi * hi, xr * hi + xi * hr);
+    }
+    plan.transform(scratch, true);
+
+    // The first `halo` outputs of each part are corrupted by circular
+    // wrap-around and are skipped.
+    size_t middle = min(outEnd, outStart + step);
+    for (size_t n = outStart; n < middle; ++n) {
+        output[n] = scratch[halo + n - outStart].real();
+    }
+    for (size_t n = middle; n < outEnd; ++n) {
+        output[n] = scratch[halo + n - middle].imag();
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef FFT_HPP
+#define FFT_HPP
+
+#include <vector>
+#include <complex>
+
+// Iterative radix-2 FFT with the bit-reversal permutation and twiddle
+// factors computed once per size. A plan is read-only after construction,
+// so several threads can transform their own buffers with the same plan.
+class FFTPlan {
+public:
+    explicit FFTPlan(size_t size);
+
+    size_t size() const { return n; }
+
+    void forward(std::vector<std::complex<float>>& data) const;
+    // Inverse transform, including the 1/N scaling.
+    void inverse(std::vector<std::complex<float>>& data) const;
+    // Either direction without any scaling.
+    void transform(std::vector<std::complex<float>>& data, bool inverse) const;
+
+private:
+    size_t n;
+    std::vector<size_t> bitReverse;
+    // Twiddles of each butterfly stage stored back to back (stage with span
+    // `length` starts at index length / 2 - 1), so the inner loop reads
+    // them contiguously.
+    std::vector<std::complex<float>> twiddles;
+};
+
+size_t nextPowerOfTwo(size_t value);
+
+// FIR filtering by overlap-save: the signal is cut into blocks of
+// blockSize() outputs, each block (plus the M-1 samples before it) is
+// transformed, multiplied by the filter spectrum and transformed back.
+// The signal and filter are real, so every transform carries two
+// neighbouring sub-blocks, one in the real and one in the imaginary part.
+// Blocks are independent, so callers may run them in any order or in
+// parallel, each with its own scratch buffer.
+class OverlapSaveConvolver {
+public:
+    explicit OverlapSaveConvolver(const std::vector<float>& coefficients);
+
+    size_t blockSize() const { return 2 * step; }
+
+    // Writes output[outStart, outEnd) for outEnd - outStart <= blockSize().
+    // Samples before the start or past the end of input count as zero.
+    void convolveBlock(const std::vector<float>& input, size_t outStart, size_t outEnd, float* output, std::vector<std::complex<float>>& scratch) const;
+
+private:
+    size_t taps;
+    size_t step;
+    FFTPlan plan;
+    std::vector<std::complex<float>> spectrum;
+};
+
+// Tap count from which applyFIRFilter switches from the scalar direct form
+// to OverlapSaveConvolver.
+const size_t FFT_CONVOLUTION_MIN_TAPS = 64;
+
+#endif
@@ -0,0 +1,244 @@
+#include "sos.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <cmath>
+#include <complex>
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+typedef complex<double> Complex;
+
+// Left half-plane poles of the order-N low-pass prototype, edge at 1 rad/s.
+vector<Complex> butterworthPrototype(int order) {
+    vector<Complex> poles;
+    for (int k = 0; k < order; ++k) {
+        double theta = M_PI * (2 * k + 1) / (2.0 * order);
+        poles.push_back(Complex(-sin(theta), cos(theta)));
+    }
+    return poles;
+}
+
+vector<Complex> chebyshevPrototype(int order, double epsilon) {
+    double mu = asinh(1.0 / epsilon) / order;
+    vector<Complex> poles;
+    for (int k = 0; k < order; ++k) {
+        double theta = M_PI * (2 * k + 1) / (2.0 * order);
+        poles.push_back(Complex(-sinh(mu) * sin(theta), cosh(mu) * cos(theta)));
+    }
+    return poles;
+}
+
+Complex sectionResponse(const Biquad& s, Complex z) {
+    Complex zi = 1.0 / z;
+    Complex num = (double)s.b0 + zi * ((double)s.b1 + zi * (double)s.b2);
+    Complex den = 1.0 + zi * ((double)s.a1 + zi * (double)s.a2);
+    return num / den;
+}
+
+Biquad makeSection(FilterBand band, double a1, double a2, bool firstOrder) {
+    Biquad s;
+    s.a1 = (float)a1;
+    s.a2 = (float)a2;
+    if (band == BAND_LOWPASS) {
+        s.b0 = 1.0f;
+        s.b1 = firstOrder ? 1.0f : 2.0f;
+        s.b2 = firstOrder ? 0.0f : 1.0f;
+    } else if (band == BAND_HIGHPASS) {
+        s.b0 = 1.0f;
+        s.b1 = firstOrder ? -1.0f : -2.0f;
+        s.b2 = firstOrder ? 0.0f : 1.0f;
+    } else {
+        s.b0 = 1.0f;
+        s.b1 = 0.0f;
+        s.b2 = -1.0f;
+    }
+    return s;
+}
+
+void checkDesign(FilterBand band, int order, double sampleRate, double cutoff, double cutoff2) {
+    double nyquist = sampleRate / 2.0;
+    if (order < 1) {
+        cerr << "Error: filter order must be at least 1" << endl;
+        exit(1);
+    }
+    if (cutoff <= 0.0 || cutoff >= nyquist) {
+        cerr << "Error: cutoff " << cutoff << " Hz is outside (0, " << nyquist << ") Hz" << endl;
+        exit(1);
+    }
+    if (band == BAND_BANDPASS && (cutoff2 <= cutoff || cutoff2 >= nyquist)) {
+        cerr << "Error: band-pass upper edge " << cutoff2 << " Hz must lie between " << cutoff << " and " << nyquist << " Hz" << endl;
+        exit(1);
+    }
+}
+
+// Maps prototype poles to the requested band, takes them through the
+// bilinear transform and groups conjugate (or real) pairs into sections.
+SOSCascade designFromPrototype(const vector<Complex>& prototype, FilterBand band, double sampleRate, double cutoff, double cutoff2) {
+    double fs2 = 2.0 * sampleRate;
+    double w1 = fs2 * tan(M_PI * cutoff / sampleRate);
+    double w2 = band == BAND_BANDPASS ? fs2 * tan(M_PI * cutoff2 / sampleRate) : 0.0;
+    double w0 = sqrt(w1 * w2);
+
+    vector<Complex> analog;
+    for (Complex p : prototype) {
+        if (band == BAND_LOWPASS) {
+            analog.push_back(p * w1);
+        } else if (band == BAND_HIGHPASS) {
+            analog.push_back(w1 / p);
+        } else {
+            Complex pb = p * (w2 - w1);
+            Complex root = sqrt(pb * pb - 4.0 * w0 * w0);
+            analog.push_back((pb + root) / 2.0);
+            analog.push_back((pb - root) / 2.0);
+        }
+    }
+
+    vector<Complex> complexPoles;
+    vector<double> realPoles;
+    for (Complex s : analog) {
+        Complex z = (fs2 + s) / (fs2 - s);
+        if (z.imag() > 1e-9) {
+            complexPoles.push_back(z);
+        } else if (z.imag() >= -1e-9) {
+            realPoles.push_back(z.real());
+        }
+    }
+
+    SOSCascade cascade;
+    for (Complex z : complexPoles) {
+        cascade.push_back(makeSection(band, -2.0 * z.real(), norm(z), false));
+    }
+    sort(realPoles.begin(), realPoles.end());
+    for (size_t i = 0; i + 1 < realPoles.size(); i += 2) {
+        double z1 = realPoles[i];
+        double z2 = realPoles[i + 1];
+        cascade.push_back(makeSection(band, -(z1 + z2), z1 * z2, false));
+    }
+    if (realPoles.size() % 2 == 1) {
+        cascade.push_back(makeSection(band, -realPoles.back(), 0.0, band != BAND_BANDPASS));
+    }
+
+    // Poles furthest from the unit circle first keeps the intermediate
+    // signals small.
+    sort(cascade.begin(), cascade.end(), [](const Biquad& x, const Biquad& y) {
+        return fabs(x.a2) < fabs(y.a2);
+    });
+
+    Complex reference = 1.0;
+    if (band == BAND_HIGHPASS) {
+        reference = -1.0;
+    } else if (band == BAND_BANDPASS) {
+        reference = polar(1.0, 2.0 * atan(w0 / fs2));
+    }
+    for (Biquad& s : cascade) {
+        float scale = (float)(1.0 / abs(sectionResponse(s, reference)));
+        s.b0 *= scale;
+        s.b1 *= scale;
+        s.b2 *= scale;
+    }
+    return cascade;
+}
+
+}
+
+SOSCascade designButterworth(FilterBand band, int order, double sampleRate, double cutoff, double cutoff2) {
+    checkDesign(band, order, sampleRate, cutoff, cutoff2);
+    return designFromPrototype(butterworthPrototype(order), band, sampleRate, cutoff, cutoff2);
+}
+
+SOSCascade designChebyshev1(FilterBand band, int order, double rippleDb, double sampleRate, double cutoff, double cutoff2) {
+    checkDesign(band, order, sampleRate, cutoff, cutoff2);
+    if (rippleDb <= 0.0) {
+        cerr << "Error: Chebyshev ripple must be positive" << endl;
+        exit(1);
+    }
+    double epsilon = sqrt(pow(10.0, rippleDb / 10.0) - 1.0);
+    SOSCascade cascade = designFromPrototype(chebyshevPrototype(order, epsilon), band, sampleRate, cutoff, cutoff2);
+    if (order % 2 == 0) {
+        float ripple = (float)(1.0 / sqrt(1.0 + epsilon * epsilon));
+        cascade[0].b0 *= ripple;
+        cascade[0].b1 *= ripple;
+        cascade[0].b2 *= ripple;
+    }
+    return cascade;
+}
+
+SOSCascade designFromSpec(const string& spec, double sampleRate) {
+    vector<string> fields;
+    stringstream ss(spec);
+    string field;
+    while (getline(ss, field, ',')) {
+        fields.push_back(field);
+    }
+
+    FilterBand band = BAND_LOWPASS;
+    if (fields.size() >= 2 && fields[1] == "highpass") {
+        band = BAND_HIGHPASS;
+    } else if (fields.size() >= 2 && fields[1] == "bandpass") {
+        band = BAND_BANDPASS;
+    } else if (fields.size() < 2 || fields[1] != "lowpass") {
+        cerr << "Error: unknown filter band in '" << spec << "' (expected lowpass, highpass or bandpass)" << endl;
+        exit(1);
+    }
+
+    size_t edges = band == BAND_BANDPASS ? 2 : 1;
+    if (fields.size() < 3 + edges) {
+        cerr << "Error: filter spec '" << spec << "' needs an order and " << edges << " cutoff(s)" << endl;
+        exit(1);
+    }
+    int order = atoi(fields[2].c_str());
+    double cutoff = atof(fields[3].c_str());
+    double cutoff2 = edges == 2 ? atof(fields[4].c_str()) : 0.0;
+
+    if (fields[0] == "butterworth") {
+        return designButterworth(band, order, sampleRate, cutoff, cutoff2);
+    }
+    if (fields[0] == "chebyshev") {
+        double rippleDb = fields.size() > 3 + edges ? atof(fields[3 + edges].c_str()) : 1.0;
+        return designChebyshev1(band, order, rippleDb, sampleRate, cutoff, cutoff2);
+    }
+    cerr << "Error: unknown filter type in '" << spec << "' (expected butterworth or chebyshev)" << endl;
+    exit(1);
+}
+
+double sosMagnitude(const SOSCascade& cascade, double sampleRate, double f) {
+    Complex z = polar(1.0, 2.0 * M_PI * f / sampleRate);
+    Complex h = 1.0;
+    for (const Biquad& s : cascade) {
+        h *= sectionResponse(s, z);
+    }
+    return abs(h);
+}
+
+void processSOS(const SOSCascade& cascade, float* data, size_t count, SOSState& state) {
+    state.resize(2 * cascade.size(), 0.0f);
+    for (size_t i = 0; i < cascade.size(); ++i) {
+        const Biquad& s = cascade[i];
+        float s1 = state[2 * i];
+        float s2 = state[2 * i + 1];
+        for (size_t n = 0; n < count; ++n) {
+            float x = data[n];
+            float y = s.b0 * x + s1;
+            s1 = s.b1 * x - s.a1 * y + s2;
+            s2 = s.b2 * x - s.a2 * y;
+            data[n] = y;
+        }
+        state[2 * i] = s1;
+        state[2 * i + 1] = s2;
+    }
+}
+
+void applySOSFilter(vector<float>& data, const SOSCascade& cascade) {
+    SOSState state;
+    processSOS(cascade, data.data(), data.size(), state);
+}
+
+void SOSStage::process(const vector<float>& input, vector<float>& output) {
+    size_t start = output.size();
+    output.insert(output.end(), input.begin(), input.end());
+    processSOS(cascade, output.data() + start, input.size(), state);
+}
@@ -0,0 +1,66 @@
+#ifndef SOS_HPP
+#define SOS_HPP
+
+#include <vector>
+#include <string>
+#include "stream.hpp"
+
+// One second-order section, normalised so a0 = 1:
+// H(z) = (b0 + b1 z^-1 + b2 z^-2) / (1 + a1 z^-1 + a2 z^-2).
+// First-order sections have b2 = a2 = 0.
+struct Biquad {
+    float b0, b1, b2;
+    float a1, a2;
+};
+
+// A filter as a cascade of biquads. Higher orders stay well conditioned
+// this way, unlike one long direct-form b/a pair.
+typedef std::vector<Biquad> SOSCascade;
+
+enum FilterBand {
+    BAND_LOWPASS,
+    BAND_HIGHPASS,
+    BAND_BANDPASS
+};
+
+// Digital Butterworth and Chebyshev type I designs via the bilinear
+// transform with pre-warped cutoffs. `order` is the prototype order (a
+// band-pass gets twice as many poles); band-pass filters use cutoff as the
+// lower and cutoff2 as the upper edge. Each section is scaled to unit gain
+// at DC, Nyquist or the band centre; even-order Chebyshev filters are then
+// scaled down so their ripple peaks at unity.
+SOSCascade designButterworth(FilterBand band, int order, double sampleRate, double cutoff, double cutoff2 = 0.0);
+SOSCascade designChebyshev1(FilterBand band, int order, double rippleDb, double sampleRate, double cutoff, double cutoff2 = 0.0);
+
+// Parses "butterworth|chebyshev,lowpass|highpass|bandpass,ORDER,CUTOFF[,CUTOFF2][,RIPPLE_DB]"
+// and designs the filter for `sampleRate`. CUTOFF2 is only given for
+// band-pass filters; the Chebyshev ripple defaults to 1 dB.
+SOSCascade designFromSpec(const std::string& spec, double sampleRate);
+
+// Magnitude of the cascade's response at frequency f (Hz).
+double sosMagnitude(const SOSCascade& cascade, double sampleRate, double f);
+
+// Filter state: the two transposed direct-form II delays of each section.
+typedef std::vector<float> SOSState;
+
+// Runs `count` samples through the cascade in place, one section at a time
+// over the block (transposed direct form II). `state` carries over between
+// calls and is sized on first use.
+void processSOS(const SOSCascade& cascade, float* data, size_t count, SOSState& state);
+
+// Whole-signal form, starting from a zero state.
+void applySOSFilter(std::vector<float>& data, const SOSCascade& cascade);
+
+class SOSStage : public FilterStage {
+public:
+    explicit SOSStage(const SOSCascade& cascade) : cascade(cascade) {}
+    void process(const std::vector<float>& input, std::vector<float>& output) override;
+    void reset() override { state.assign(state.size(), 0.0f); }
+    bool tileable() const override { return false; }
+
+private:
+    SOSCascade cascade;
+    SOSState state;
+};
+
+#endif
@@ -0,0 +1,349 @@
+#include "stream.hpp"
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+void GainStage::process(const vector<float>& input, vector<float>& output) {
+    for (float sample : input) {
+        output.push_back(sample * gain);
+    }
+}
+
+void NormalizeStage::process(const vector<float>& input, vector<float>& output) {
+    for (float sample : input) {
+        output.push_back(peak > 0 ? sample / peak : sample);
+    }
+}
+
+FIRStage::FIRStage(const vector<float>& coefficients) : coefficients(coefficients) {
+    if (coefficients.size() >= FFT_CONVOLUTION_MIN_TAPS) {
+        convolver.reset(new OverlapSaveConvolver(coefficients));
+    }
+    window.assign(coefficients.empty() ? 0 : coefficients.size() - 1, 0.0f);
+}
+
+void FIRStage::process(const vector<float>& input, vector<float>& output) {
+    if (coefficients.empty()) {
+        output.insert(output.end(), input.size(), 0.0f);
+        return;
+    }
+
+    // window = last M-1 inputs of the previous block followed by this block.
+    size_t halo = coefficients.size() - 1;
+    window.resize(halo);
+    window.insert(window.end(), input.begin(), input.end());
+
+    filtered.resize(window.size());
+    if (convolver) {
+        for (size_t start = halo; start < window.size(); start += convolver->blockSize()) {
+            size_t end = min(window.size(), start + convolver->blockSize());
+            convolver->convolveBlock(window, start, end, filtered.data(), scratch);
+        }
+    } else {
+        for (size_t n = halo; n < window.size(); ++n) {
+            float sum = 0.0f;
+            for (size_t k = 0; k <= halo; ++k) {
+                sum += coefficients[k] * window[n - k];
+            }
+            filtered[n] = sum;
+        }
+    }
+    output.insert(output.end(), filtered.begin() + halo, filtered.end());
+
+    window.erase(window.begin(), window.end() - halo);
+}
+
+void FIRStage::reset() {
+    window.assign(coefficients.empty() ? 0 : coefficients.size() - 1, 0.0f);
+}
+
+IIRStage::IIRStage(const vector<float>& b, const vector<float>& a)
+    : b(b), a(a), inputHistory(b.size(), 0.0f), outputHistory(a.size(), 0.0f) {}
+
+void IIRStage::process(const vector<float>& input, vector<float>& output) {
+    size_t P = b.size();
+    size_t Q = a.size();
+
+    // History arrays keep the newest sample at index 0.
+    for (float sample : input) {
+        for (size_t i = P; i-- > 1;) {
+            inputHistory[i] = inputHistory[i - 1];
+        }
+        if (P > 0) {
+            inputHistory[0] = sample;
+        }
+
+        float y = 0.0f;
+        for (size_t i = 0; i < P; ++i) {
+            y += b[i] * inputHistory[i];
+        }
+        for (size_t j = 1; j < Q; ++j) {
+            y -= a[j] * outputHistory[j - 1];
+        }
+
+        for (size_t j = Q; j-- > 1;) {
+            outputHistory[j] = outputHistory[j - 1];
+        }
+        outputHistory[0] = y;
+        output.push_back(y);
+    }
+}
+
+void IIRStage::reset() {
+    std::fill(inputHistory.begin(), inputHistory.end(), 0.0f);
+    std::fill(outputHistory.begin(), outputHistory.end(), 0.0f);
+}
+
+SpectralStage::SpectralStage(int sampleRate, const function<float(float)>& response, size_t frameSize)
+    : SpectralStage(designSpectralGains(sampleRate, frameSize, response)) {}
+
+SpectralStage::SpectralStage(const SampleTable& gains)
+    : plan(gains->size()), frameSize(gains->size()), hop(frameSize / 2), window(hannWindow(frameSize)), gains(gains),
+      overlap(frameSize, 0.0f), skip(frameSize / 2), consumed(0), produced(0) {
+    // The first frame starts one hop before the signal, like in the
+    // in-memory version, so the first hop is covered twice as well.
+    pending.assign(hop, 0.0f);
+}
+
+void SpectralStage::reset() {
+    pending.assign(hop, 0.0f);
+    std::fill(overlap.begin(), overlap.end(), 0.0f);
+    skip = frameSize / 2;
+    consumed = 0;
+    produced = 0;
+}
+
+void SpectralStage::emitHop(const float* frameOutput, vector<float>& output) {
+    for (size_t i = 0; i < frameSize; ++i) {
+        overlap[i] += frameOutput[2 * i];
+    }
+
+    // The first hop of the accumulator has now seen both of its frames.
+    size_t ready = hop;
+    size_t dropped = min(skip, ready);
+    skip -= dropped;
+    size_t emit = min(ready - dropped, consumed - produced);
+    output.insert(output.end(), overlap.begin() + dropped, overlap.begin() + dropped + emit);
+    produced += emit;
+
+    std::copy(overlap.begin() + hop, overlap.end(), overlap.begin());
+    std::fill(overlap.end() - hop, overlap.end(), 0.0f);
+}
+
+void SpectralStage::processFrames(vector<float>& output) {
+    // Frames are read at an advancing offset and the consumed prefix is
+    // dropped once at the end, so a large block costs one move, not one
+    // per hop. When the next frame is also complete it rides along in the
+    // imaginary part of the same transform, as in applySpectralFilter.
+    size_t offset = 0;
+    while (pending.size() - offset >= frameSize) {
+        bool paired = pending.size() - offset >= frameSize + hop;
+        scratch.resize(frameSize);
+        const float* frame = pending.data() + offset;
+        const float* w = window->data();
+        const float* g = gains->data();
+        for (size_t i = 0; i < frameSize; ++i) {
+            float next = paired ? frame[hop + i] * w[i] : 0.0f;
+            scratch[i] = complex<float>(frame[i] * w[i], next);
+        }
+        plan.transform(scratch, false);
+        for (size_t k = 0; k < frameSize; ++k) {
+            scratch[k] *= g[k];
+        }
+        plan.transform(scratch, true);
+
+        const float* result = reinterpret_cast<const float*>(scratch.data());
+        emitHop(result, output);
+        offset += hop;
+        if (paired) {
+            emitHop(result + 1, output);
+            offset += hop;
+        }
+    }
+    pending.erase(pending.begin(), pending.begin() + offset);
+}
+
+void SpectralStage::process(const vector<float>& input, vector<float>& output) {
+    pending.insert(pending.end(), input.begin(), input.end());
+    consumed += input.size();
+    processFrames(output);
+}
+
+void SpectralStage::flush(vector<float>& output) {
+    while (produced < consumed) {
+        pending.insert(pending.end(), hop, 0.0f);
+        processFrames(output);
+    }
+}
+
+void FilterChain::run(size_t first, vector<float>& buffer, vector<float>& output) {
+    for (size_t i = first; i < stages.size(); ++i) {
+        next.clear();
+        stages[i]->process(buffer, next);
+        buffer.swap(next);
+    }
+    output.insert(output.end(), buffer.begin(), buffer.end());
+}
+
+void FilterChain::process(const vector<float>& input, vector<float>& output) {
+    current.assign(input.begin(), input.end());
+    run(0, current, output);
+}
+
+void FilterChain::flush(vector<float>& output) {
+    for (size_t i = 0; i < stages.size(); ++i) {
+        current.clear();
+        stages[i]->flush(current);
+        run(i + 1, current, output);
+    }
+}
+
+void FilterChain::reset() {
+    for (auto& stage : stages) {
+        stage->reset();
+    }
+}
+
+bool FilterChain::tileable() const {
+    for (const auto& stage : stages) {
+        if (!stage->tileable()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t FilterChain::history() const {
+    size_t total = 0;
+    for (const auto& stage : stages) {
+        total += stage->history();
+    }
+    return total;
+}
+
+size_t FilterChain::lookahead() const {
+    size_t total = 0;
+    for (const auto& stage : stages) {
+        total += stage->lookahead();
+    }
+    return total;
+}
+
+size_t FilterChain::alignment() const {
+    size_t result = 1;
+    for (const auto& stage : stages) {
+        size_t a = result;
+        size_t b = stage->alignment();
+        while (b != 0) {
+            size_t t = a % b;
+            a = b;
+            b = t;
+        }
+        result = result / a * stage->alignment();
+    }
+    return result;
+}
+
+SF_INFO readStreamInfo(const string& inputFile) {
+    SF_INFO fileInfo;
+    fileInfo.format = 0;
+    SNDFILE* inFile = sf_open(inputFile.c_str(), SFM_READ, &fileInfo);
+    if (!inFile) {
+        std::cerr << "Error opening input file: " << sf_strerror(NULL) << std::endl;
+        exit(1);
+    }
+    sf_close(inFile);
+    return fileInfo;
+}
+
+float streamPeakSample(const string& inputFile, size_t blockFrames) {
+    SF_INFO fileInfo;
+    fileInfo.format = 0;
+    SNDFILE* inFile = sf_open(inputFile.c_str(), SFM_READ, &fileInfo);
+    if (!inFile) {
+        std::cerr << "Error opening input file: " << sf_strerror(NULL) << std::endl;
+        exit(1);
+    }
+
+    vector<float> block(blockFrames * fileInfo.channels);
+    float peak = 0.0f;
+    sf_count_t frames;
+    while ((frames = sf_readf_float(inFile, block.data(), blockFrames)) > 0) {
+        for (sf_count_t i = 0; i < frames * fileInfo.channels; ++i) {
+            if (std::abs(block[i]) > std::abs(peak)) {
+                peak = block[i];
+            }
+        }
+    }
+
+    sf_close(inFile);
+    return peak;
+}
+
+void streamFilterChains(const string& inputFile, vector<FilterChain>& chains, const vector<string>& outputFiles, size_t blockFrames, const ChainRunner& runner) {
+    SF_INFO fileInfo;
+    fileInfo.format = 0;
+    SNDFILE* inFile = sf_open(inputFile.c_str(), SFM_READ, &fileInfo);
+    if (!inFile) {
+        std::cerr << "Error opening input file: " << sf_strerror(NULL) << std::endl;
+        exit(1);
+    }
+
+    vector<SNDFILE*> outFiles(chains.size());
+    for (size_t i = 0; i < chains.size(); ++i) {
+        SF_INFO outInfo = fileInfo;
+        outFiles[i] = sf_open(outputFiles[i].c_str(), SFM_WRITE, &outInfo);
+        if (!outFiles[i]) {
+            std::cerr << "Error opening output file: " << sf_strerror(NULL) << std::endl;
+            exit(1);
+        }
+    }
+
+    int channels = fileInfo.channels;
+    vector<float> block(blockFrames * channels);
+    vector<vector<float>> filtered(chains.size());
+
+    // Look-ahead stages release samples in hops that need not line up with
+    // frames, so a partial frame waits in `filtered` for the next block.
+    auto writeFiltered = [&](size_t i) {
+        sf_count_t frames = filtered[i].size() / channels;
+        if (sf_writef_float(outFiles[i], filtered[i].data(), frames) != frames) {
+            std::cerr << "Error writing frames to file." << std::endl;
+            exit(1);
+        }
+        filtered[i].erase(filtered[i].begin(), filtered[i].begin() + frames * channels);
+    };
+
+    auto forEachChain = [&](const function<void(size_t)>& body) {
+        if (runner) {
+            runner(chains.size(), body);
+        } else {
+            for (size_t i = 0; i < chains.size(); ++i) {
+                body(i);
+            }
+        }
+    };
+
+    sf_count_t frames;
+    while ((frames = sf_readf_float(inFile, block.data(), blockFrames)) > 0) {
+        block.resize(frames * channels);
+        forEachChain([&](size_t i) {
+            chains[i].process(block, filtered[i]);
+            writeFiltered(i);
+        });
+        block.resize(blockFrames * channels);
+    }
+
+    forEachChain([&](size_t i) {
+        chains[i].flush(filtered[i]);
+        writeFiltered(i);
+    });
+
+    sf_close(inFile);
+    for (SNDFILE* outFile : outFiles) {
+        sf_close(outFile);
+    }
+}
@@ -0,0 +1,171 @@
+#ifndef STREAM_HPP
+#define STREAM_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <complex>
+#include <sndfile.h>
+#include "fft.hpp"
+#include "design.hpp"
+
+// One step of a streaming filter chain. Stages keep whatever history they
+// need between calls, so feeding a signal block by block gives the same
+// result as filtering it in one piece.
+class FilterStage {
+public:
+    virtual ~FilterStage() {}
+
+    // Consumes `input` and appends every output sample that is ready to
+    // `output`. Stages with look-ahead may hold samples back.
+    virtual void process(const std::vector<float>& input, std::vector<float>& output) = 0;
+
+    // Called once after the last block; appends any held-back samples.
+    virtual void flush(std::vector<float>& output) { (void)output; }
+
+    // Returns to the state right after construction but keeps the buffers,
+    // so one chain can filter several independent signals.
+    virtual void reset() {}
+
+    // Context needed to filter a slice of a signal on its own: output n
+    // depends on inputs [n - history(), n + lookahead()], and the slice
+    // must start at a multiple of alignment() from the signal start.
+    // Recursive stages depend on the whole past and are not tileable.
+    virtual bool tileable() const { return true; }
+    virtual size_t history() const { return 0; }
+    virtual size_t lookahead() const { return 0; }
+    virtual size_t alignment() const { return 1; }
+};
+
+class GainStage : public FilterStage {
+public:
+    explicit GainStage(float gain) : gain(gain) {}
+    void process(const std::vector<float>& input, std::vector<float>& output) override;
+
+private:
+    float gain;
+};
+
+// Divides by the peak sample, as the in-memory normalizeAudio does, so a
+// streamed run rounds exactly like it (multiplying by 1/peak does not).
+class NormalizeStage : public FilterStage {
+public:
+    explicit NormalizeStage(float peak) : peak(peak) {}
+    void process(const std::vector<float>& input, std::vector<float>& output) override;
+
+private:
+    float peak;
+};
+
+// Direct-form FIR carrying the last M-1 inputs across blocks. Long filters
+// (FFT_CONVOLUTION_MIN_TAPS and up) are evaluated with OverlapSaveConvolver.
+class FIRStage : public FilterStage {
+public:
+    explicit FIRStage(const std::vector<float>& coefficients);
+    void process(const std::vector<float>& input, std::vector<float>& output) override;
+    void reset() override;
+    size_t history() const override { return coefficients.empty() ? 0 : coefficients.size() - 1; }
+
+private:
+    std::vector<float> coefficients;
+    std::unique_ptr<OverlapSaveConvolver> convolver;
+    std::vector<float> window;
+    std::vector<float> filtered;
+    std::vector<std::complex<float>> scratch;
+};
+
+// Direct-form IIR (a[0] taken as 1) carrying the last inputs and outputs
+// across blocks.
+class IIRStage : public FilterStage {
+public:
+    IIRStage(const std::vector<float>& b, const std::vector<float>& a);
+    void process(const std::vector<float>& input, std::vector<float>& output) override;
+    void reset() override;
+    bool tileable() const override { return false; }
+
+private:
+    std::vector<float> b;
+    std::vector<float> a;
+    std::vector<float> inputHistory;
+    std::vector<float> outputHistory;
+};
+
+// Streaming form of the STFT filter: Hann frames with 50% overlap, each
+// bin scaled by response(f). Output lags the input by one frame and is
+// released hop samples at a time; flush() drains the tail so the output
+// has exactly as many samples as the input.
+class SpectralStage : public FilterStage {
+public:
+    SpectralStage(int sampleRate, const std::function<float(float)>& response, size_t frameSize = 2048);
+    // Per-bin gains from the design layer; the frame size is gains->size().
+    explicit SpectralStage(const SampleTable& gains);
+    void process(const std::vector<float>& input, std::vector<float>& output) override;
+    void flush(std::vector<float>& output) override;
+    void reset() override;
+    size_t history() const override { return frameSize; }
+    size_t lookahead() const override { return frameSize; }
+    size_t alignment() const override { return hop; }
+
+private:
+    void processFrames(std::vector<float>& output);
+    void emitHop(const float* frameOutput, std::vector<float>& output);
+
+    FFTPlan plan;
+    size_t frameSize;
+    size_t hop;
+    SampleTable window;
+    SampleTable gains;
+    std::vector<float> pending;
+    std::vector<float> overlap;
+    std::vector<std::complex<float>> scratch;
+    size_t skip;
+    size_t consumed;
+    size_t produced;
+};
+
+// Runs a block through several stages in order, flushing them in order at
+// the end of the stream.
+class FilterChain {
+public:
+    void add(FilterStage* stage) { stages.emplace_back(stage); }
+    void process(const std::vector<float>& input, std::vector<float>& output);
+    void flush(std::vector<float>& output);
+    void reset();
+
+    // Combined context of all stages (see FilterStage::history).
+    bool tileable() const;
+    size_t history() const;
+    size_t lookahead() const;
+    size_t alignment() const;
+
+private:
+    void run(size_t first, std::vector<float>& buffer, std::vector<float>& output);
+
+    std::vector<std::unique_ptr<FilterStage>> stages;
+    std::vector<float> current;
+    std::vector<float> next;
+};
+
+// Fills an empty chain with stages. Used where one chain description has to
+// be instantiated several times, e.g. once per channel or per tile.
+typedef std::function<void(FilterChain&)> ChainBuilder;
+
+const size_t STREAM_BLOCK_FRAMES = 65536;
+
+SF_INFO readStreamInfo(const std::string& inputFile);
+
+// runner(count, body) must call body(i) once for every i < count; the
+// parallel build passes one that spreads the calls over its thread pool.
+typedef std::function<void(size_t, const std::function<void(size_t)>&)> ChainRunner;
+
+// Reads the input once, blockFrames at a time, feeds every block to each
+// chain and writes chain i to outputFiles[i]. Memory stays proportional to
+// the block size whatever the file length.
+void streamFilterChains(const std::string& inputFile, std::vector<FilterChain>& chains, const std::vector<std::string>& outputFiles, size_t blockFrames, const ChainRunner& runner = ChainRunner());
+
+// The sample with the largest magnitude in the file (sign included, as
+// normalizeAudio uses it), read blockFrames at a time.
+float streamPeakSample(const std::string& inputFile, size_t blockFrames);
+
+#endif
@@ -0,0 +1,130 @@
+#include "batch.hpp"
+#include "thread_pool.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <chrono>
+#include <cstdlib>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static bool hasWavExtension(const string& name) {
+    if (name.size() < 4) {
+        return false;
+    }
+    string extension = name.substr(name.size() - 4);
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".wav";
+}
+
+vector<string> listBatchInputs(const string& path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        cerr << "Error: cannot open batch input " << path << endl;
+        exit(1);
+    }
+
+    vector<string> files;
+    if (S_ISDIR(info.st_mode)) {
+        DIR* dir = opendir(path.c_str());
+        if (!dir) {
+            cerr << "Error: cannot read directory " << path << endl;
+            exit(1);
+        }
+        while (struct dirent* entry = readdir(dir)) {
+            string name = entry->d_name;
+            if (hasWavExtension(name)) {
+                files.push_back(path + "/" + name);
+            }
+        }
+        closedir(dir);
+        sort(files.begin(), files.end());
+        return files;
+    }
+
+    ifstream manifest(path);
+    string line;
+    while (getline(manifest, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty() && line[0] != '#') {
+            files.push_back(line);
+        }
+    }
+    return files;
+}
+
+vector<string> batchOutputStems(const vector<string>& files) {
+    vector<string> stems;
+    map<string, size_t> uses;
+    for (const string& file : files) {
+        string stem = file.substr(file.find_last_of('/') + 1);
+        stem = stem.substr(0, stem.find_last_of('.'));
+        stems.push_back(stem);
+        ++uses[stem];
+    }
+
+    set<string> taken(stems.begin(), stems.end());
+    for (size_t i = 0; i < stems.size(); ++i) {
+        if (uses[stems[i]] < 2) {
+            continue;
+        }
+        // Keep going if another input is already called x_2.
+        string renamed = stems[i] + "_" + to_string(i + 1);
+        while (taken.count(renamed)) {
+            renamed += "_" + to_string(i + 1);
+        }
+        taken.insert(renamed);
+        cerr << "Warning: batch inputs share the name " << stems[i] << "; writing " << files[i] << " as " << renamed << endl;
+        stems[i] = renamed;
+    }
+    return stems;
+}
+
+BatchStats runBatch(const vector<string>& files, const function<size_t(size_t)>& processFile) {
+    auto start = chrono::high_resolution_clock::now();
+
+    vector<pair<size_t, size_t>> small;
+    vector<size_t> large;
+    for (size_t i = 0; i < files.size(); ++i) {
+        struct stat info;
+        size_t bytes = stat(files[i].c_str(), &info) == 0 ? info.st_size : 0;
+        if (bytes >= BATCH_LARGE_FILE_BYTES) {
+            large.push_back(i);
+        } else {
+            small.push_back(make_pair(bytes, i));
+        }
+    }
+    sort(small.begin(), small.end(), [](const pair<size_t, size_t>& x, const pair<size_t, size_t>& y) {
+        return x.first > y.first;
+    });
+
+    // Inside a file task the filters' own parallelFor calls find the other
+    // workers busy and mostly run on the calling thread.
+    vector<size_t> samples(small.size(), 0);
+    globalPool().parallelFor(0, small.size(), [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            samples[i] = processFile(small[i].second);
+        }
+    }, 1);
+
+    BatchStats stats;
+    stats.files = files.size();
+    stats.largeFiles = large.size();
+    stats.samples = 0;
+    for (size_t count : samples) {
+        stats.samples += count;
+    }
+    for (size_t index : large) {
+        stats.samples += processFile(index);
+    }
+
+    stats.seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+    return stats;
+}
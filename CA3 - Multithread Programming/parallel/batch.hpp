@@ -0,0 +1,37 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <vector>
+#include <string>
+#include <functional>
+
+// Files at least this large are filtered one at a time with the whole pool
+// (intra-file parallelism); smaller ones are spread across the pool whole.
+const size_t BATCH_LARGE_FILE_BYTES = 8 << 20;
+
+struct BatchStats {
+    size_t files;
+    size_t largeFiles;
+    size_t samples;
+    double seconds;
+};
+
+// The inputs of a batch run: the .wav files in a directory, or the paths in
+// a manifest file, one per line (blank lines and lines starting with # are
+// skipped). Directory entries come back sorted by name.
+std::vector<std::string> listBatchInputs(const std::string& path);
+
+// Output name prefix per input: the file name without its extension, so
+// clip.wav -> clip. Inputs that share a name (a manifest listing a/x.wav
+// and b/x.wav) get their 1-based position in the list appended, x_1 and
+// x_2, instead of overwriting each other's outputs; each such rename is
+// reported on stderr.
+std::vector<std::string> batchOutputStems(const std::vector<std::string>& files);
+
+// Runs processFile(i) for every files[i] and times the whole batch.
+// processFile returns the number of samples it filtered. Small files are
+// handed out largest first, one per chunk, so a worker that finishes early
+// picks up the next file instead of idling behind a long one.
+BatchStats runBatch(const std::vector<std::string>& files, const std::function<size_t(size_t)>& processFile);
+
+#endif
@@ -0,0 +1,204 @@
+#include "fir_kernels.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+void firKernelScalar(const float* input, float* output, size_t count, const float* coefficients, size_t taps) {
+    for (size_t n = 0; n < count; ++n) {
+        float sum = 0.0f;
+        for (size_t k = 0; k < taps; ++k) {
+            sum += coefficients[k] * input[n - k];
+        }
+        output[n] = sum;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Vectorised over output samples: each tap is broadcast once and multiplied
+// into a block of consecutive outputs, so the input loads are contiguous.
+void firKernelSSE(const float* input, float* output, size_t count, const float* coefficients, size_t taps) {
+    size_t n = 0;
+    for (; n + 8 <= count; n += 8) {
+        __m128 sum0 = _mm_setzero_ps();
+        __m128 sum1 = _mm_setzero_ps();
+        for (size_t k = 0; k < taps; ++k) {
+            __m128 c = _mm_set1_ps(coefficients[k]);
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(c, _mm_loadu_ps(input + n - k)));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(c, _mm_loadu_ps(input + n + 4 - k)));
+        }
+        _mm_storeu_ps(output + n, sum0);
+        _mm_storeu_ps(output + n + 4, sum1);
+    }
+    firKernelScalar(input + n, output + n, count - n, coefficients, taps);
+}
+
+__attribute__((target("avx2,fma")))
+void firKernelAVX2(const float* input, float* output, size_t count, const float* coefficients, size_t taps) {
+    size_t n = 0;
+    for (; n + 16 <= count; n += 16) {
+        __m256 sum0 = _mm256_setzero_ps();
+        __m256 sum1 = _mm256_setzero_ps();
+        for (size_t k = 0; k < taps; ++k) {
+            __m256 c = _mm256_set1_ps(coefficients[k]);
+            sum0 = _mm256_fmadd_ps(c, _mm256_loadu_ps(input + n - k), sum0);
+            sum1 = _mm256_fmadd_ps(c, _mm256_loadu_ps(input + n + 8 - k), sum1);
+        }
+        _mm256_storeu_ps(output + n, sum0);
+        _mm256_storeu_ps(output + n + 8, sum1);
+    }
+    firKernelSSE(input + n, output + n, count - n, coefficients, taps);
+}
+
+#endif
+
+template <size_t TAPS>
+static void firKernelScalarFixed(const float* input, float* output, size_t count, const float* coefficients, size_t) {
+    float c[TAPS];
+    for (size_t k = 0; k < TAPS; ++k) {
+        c[k] = coefficients[k];
+    }
+    for (size_t n = 0; n < count; ++n) {
+        float sum = 0.0f;
+        for (size_t k = 0; k < TAPS; ++k) {
+            sum += c[k] * input[n - k];
+        }
+        output[n] = sum;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+template <size_t TAPS>
+static void firKernelSSEFixed(const float* input, float* output, size_t count, const float* coefficients, size_t taps) {
+    __m128 c[TAPS];
+    for (size_t k = 0; k < TAPS; ++k) {
+        c[k] = _mm_set1_ps(coefficients[k]);
+    }
+    size_t n = 0;
+    for (; n + 8 <= count; n += 8) {
+        __m128 sum0 = _mm_setzero_ps();
+        __m128 sum1 = _mm_setzero_ps();
+        for (size_t k = 0; k < TAPS; ++k) {
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(c[k], _mm_loadu_ps(input + n - k)));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(c[k], _mm_loadu_ps(input + n + 4 - k)));
+        }
+        _mm_storeu_ps(output + n, sum0);
+        _mm_storeu_ps(output + n + 4, sum1);
+    }
+    firKernelScalarFixed<TAPS>(input + n, output + n, count - n, coefficients, taps);
+}
+
+template <size_t TAPS>
+__attribute__((target("avx2,fma")))
+static void firKernelAVX2Fixed(const float* input, float* output, size_t count, const float* coefficients, size_t taps) {
+    __m256 c[TAPS];
+    for (size_t k = 0; k < TAPS; ++k) {
+        c[k] = _mm256_set1_ps(coefficients[k]);
+    }
+    size_t n = 0;
+    for (; n + 16 <= count; n += 16) {
+        __m256 sum0 = _mm256_setzero_ps();
+        __m256 sum1 = _mm256_setzero_ps();
+        for (size_t k = 0; k < TAPS; ++k) {
+            sum0 = _mm256_fmadd_ps(c[k], _mm256_loadu_ps(input + n - k), sum0);
+            sum1 = _mm256_fmadd_ps(c[k], _mm256_loadu_ps(input + n + 8 - k), sum1);
+        }
+        _mm256_storeu_ps(output + n, sum0);
+        _mm256_storeu_ps(output + n + 8, sum1);
+    }
+    firKernelSSEFixed<TAPS>(input + n, output + n, count - n, coefficients, taps);
+}
+
+#endif
+
+namespace {
+
+struct FixedFIRKernels {
+    size_t taps;
+    FIRKernel scalar;
+    FIRKernel sse;
+    FIRKernel avx2;
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FIXED_FIR_KERNELS(TAPS) {TAPS, firKernelScalarFixed<TAPS>, firKernelSSEFixed<TAPS>, firKernelAVX2Fixed<TAPS>}
+#else
+#define FIXED_FIR_KERNELS(TAPS) {TAPS, firKernelScalarFixed<TAPS>, NULL, NULL}
+#endif
+
+const FixedFIRKernels fixedKernels[] = {
+    FIXED_FIR_KERNELS(3),
+    FIXED_FIR_KERNELS(5),
+    FIXED_FIR_KERNELS(7),
+    FIXED_FIR_KERNELS(9),
+};
+
+}
+
+FIRKernel selectFIRKernel(size_t taps) {
+    FIRKernel generic = selectFIRKernel();
+    for (const FixedFIRKernels& fixed : fixedKernels) {
+        if (fixed.taps != taps) {
+            continue;
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        if (generic == firKernelAVX2) {
+            return fixed.avx2;
+        }
+        if (generic == firKernelSSE) {
+            return fixed.sse;
+        }
+#endif
+        return fixed.scalar;
+    }
+    return generic;
+}
+
+FIRKernel selectFIRKernel() {
+    const char* forced = getenv("FILTER_SIMD");
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    bool hasAVX2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (forced != NULL) {
+        if (strcmp(forced, "avx2") == 0 && hasAVX2) {
+            return firKernelAVX2;
+        }
+        if (strcmp(forced, "sse") == 0) {
+            return firKernelSSE;
+        }
+        return firKernelScalar;
+    }
+    return hasAVX2 ? firKernelAVX2 : firKernelSSE;
+#else
+    (void)forced;
+    return firKernelScalar;
+#endif
+}
+
+const char* firKernelName(FIRKernel kernel) {
+    for (const FixedFIRKernels& fixed : fixedKernels) {
+        if (kernel == fixed.scalar) {
+            return "scalar (fixed taps)";
+        }
+        if (kernel == fixed.sse) {
+            return "sse (fixed taps)";
+        }
+        if (kernel == fixed.avx2) {
+            return "avx2 (fixed taps)";
+        }
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    if (kernel == firKernelAVX2) {
+        return "avx2";
+    }
+    if (kernel == firKernelSSE) {
+        return "sse";
+    }
+#endif
+    return kernel == firKernelScalar ? "scalar" : "unknown";
+}
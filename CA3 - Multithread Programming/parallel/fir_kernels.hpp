@@ -0,0 +1,32 @@
+#ifndef FIR_KERNELS_HPP
+#define FIR_KERNELS_HPP
+
+#include <cstddef>
+
+// Computes output[n] = sum_k coefficients[k] * input[n - k] for n in
+// [0, count). The caller guarantees input[-(taps - 1)] .. input[count - 1]
+// are readable, so the kernels carry no boundary checks.
+typedef void (*FIRKernel)(const float* input, float* output, size_t count, const float* coefficients, size_t taps);
+
+void firKernelScalar(const float* input, float* output, size_t count, const float* coefficients, size_t taps);
+#if defined(__x86_64__) || defined(__i386__)
+void firKernelSSE(const float* input, float* output, size_t count, const float* coefficients, size_t taps);
+void firKernelAVX2(const float* input, float* output, size_t count, const float* coefficients, size_t taps);
+#endif
+
+// The vector kernels stay ahead of the FFT path for longer filters than the
+// scalar one does (FFT_CONVOLUTION_MIN_TAPS), so they switch later.
+const size_t FFT_CONVOLUTION_MIN_TAPS_SIMD = 192;
+
+// Picks the widest kernel the CPU supports. FILTER_SIMD=scalar|sse|avx2
+// forces a specific one (falling back to scalar if it is unavailable).
+FIRKernel selectFIRKernel();
+const char* firKernelName(FIRKernel kernel);
+
+// Same choice of instruction set, but for 3, 5, 7 or 9 taps it returns a
+// kernel with the tap count fixed at compile time: the tap loop unrolls and
+// the broadcast coefficients stay in registers. Other lengths get the
+// generic kernel.
+FIRKernel selectFIRKernel(size_t taps);
+
+#endif
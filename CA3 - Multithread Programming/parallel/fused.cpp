@@ -0,0 +1,80 @@
+#include "fused.hpp"
+#include "thread_pool.hpp"
+#include "memory.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <atomic>
+#include <unistd.h>
+
+using namespace std;
+
+static atomic<size_t> fusedCalls(0);
+
+size_t fusedTileSamples() {
+    long l2Bytes = -1;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    l2Bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (l2Bytes <= 0) {
+        l2Bytes = 256 * 1024;
+    }
+    // Input, output and two intermediate buffers per tile.
+    size_t samples = static_cast<size_t>(l2Bytes) / (4 * sizeof(float));
+    return max<size_t>(samples, 4096);
+}
+
+void applyFusedChain(vector<float>& data, const ChainBuilder& build, size_t tileSamples) {
+    StageScope stage("fused");
+    FilterChain probe;
+    build(probe);
+    if (!probe.tileable()) {
+        cerr << "Error: fused chains cannot contain recursive (IIR) stages" << endl;
+        exit(1);
+    }
+    size_t history = probe.history();
+    size_t lookahead = probe.lookahead();
+    size_t alignment = probe.alignment();
+    if (tileSamples == 0) {
+        tileSamples = fusedTileSamples();
+    }
+    // Whole grid steps per tile, so tile edges never split a frame.
+    tileSamples = (tileSamples + alignment - 1) / alignment * alignment;
+
+    size_t total = data.size();
+    size_t tiles = (total + tileSamples - 1) / tileSamples;
+    vector<float> result(total);
+    releaseForFirstTouch(result);
+    size_t call = ++fusedCalls;
+
+    globalPool().parallelFor(0, tiles, [&](size_t first, size_t last) {
+        thread_local unique_ptr<FilterChain> chain;
+        thread_local size_t chainCall = 0;
+        if (chainCall != call) {
+            chain.reset(new FilterChain);
+            build(*chain);
+            chainCall = call;
+        }
+        vector<float>& input = threadScratch().samples;
+        vector<float>& output = threadScratch().output;
+        for (size_t tile = first; tile < last; ++tile) {
+            size_t tileStart = tile * tileSamples;
+            size_t tileEnd = min(total, tileStart + tileSamples);
+            size_t fedStart = tileStart > history ? tileStart - history : 0;
+            fedStart -= fedStart % alignment;
+            size_t fedEnd = min(total, tileEnd + lookahead);
+
+            chain->reset();
+            input.assign(data.begin() + fedStart, data.begin() + fedEnd);
+            output.clear();
+            chain->process(input, output);
+            chain->flush(output);
+
+            std::copy(output.begin() + (tileStart - fedStart), output.begin() + (tileEnd - fedStart),
+                      result.begin() + tileStart);
+        }
+    }, 1);
+
+    data.swap(result);
+}
@@ -0,0 +1,22 @@
+#ifndef FUSED_HPP
+#define FUSED_HPP
+
+#include <vector>
+#include <functional>
+#include "../common/stream.hpp"
+
+// Samples per tile, sized so a tile and the intermediate buffers of a few
+// stages stay in one core's L2 cache. Falls back to 256 KiB of L2 when the
+// system does not report it.
+size_t fusedTileSamples();
+
+// Runs every stage of the chain over one tile before moving to the next,
+// instead of one full pass over `data` per filter. Tiles are filtered on the
+// pool; each one is widened by the chain's history and lookahead and started
+// on its alignment grid, so the result matches running the stages one after
+// another over the whole signal. The chain must be tileable (no IIR).
+// `build` is called once per thread and call; the chain is reset between
+// tiles, so its stages start every tile fresh without being reallocated.
+void applyFusedChain(std::vector<float>& data, const ChainBuilder& build, size_t tileSamples = 0);
+
+#endif
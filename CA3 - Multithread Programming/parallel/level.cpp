@@ -0,0 +1,296 @@
+#include "level.hpp"
+#include "thread_pool.hpp"
+#include "fir_kernels.hpp"
+
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Fixed chunk size, so the partial sums (and their rounding) do not depend
+// on the number of threads.
+const size_t LEVEL_GRAIN = 1 << 16;
+
+typedef void (*LevelKernel)(const float* samples, size_t count, LevelSums& level);
+typedef void (*ScaleKernel)(float* samples, size_t count, float gain);
+
+static void levelKernelScalar(const float* samples, size_t count, LevelSums& level) {
+    for (size_t i = 0; i < count; ++i) {
+        float x = samples[i];
+        level.minSample = min(level.minSample, x);
+        level.maxSample = max(level.maxSample, x);
+        level.sumSquares += (double)x * x;
+    }
+    level.count += count;
+}
+
+static void scaleKernelScalar(float* samples, size_t count, float gain) {
+    for (size_t i = 0; i < count; ++i) {
+        samples[i] *= gain;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+static void levelKernelSSE(const float* samples, size_t count, LevelSums& level) {
+    __m128 lo = _mm_set1_ps(level.minSample);
+    __m128 hi = _mm_set1_ps(level.maxSample);
+    __m128d squares = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(samples + i);
+        lo = _mm_min_ps(lo, x);
+        hi = _mm_max_ps(hi, x);
+        __m128d x01 = _mm_cvtps_pd(x);
+        __m128d x23 = _mm_cvtps_pd(_mm_movehl_ps(x, x));
+        squares = _mm_add_pd(squares, _mm_add_pd(_mm_mul_pd(x01, x01), _mm_mul_pd(x23, x23)));
+    }
+
+    float los[4], his[4];
+    double sums[2];
+    _mm_storeu_ps(los, lo);
+    _mm_storeu_ps(his, hi);
+    _mm_storeu_pd(sums, squares);
+    for (int k = 0; k < 4; ++k) {
+        level.minSample = min(level.minSample, los[k]);
+        level.maxSample = max(level.maxSample, his[k]);
+    }
+    level.sumSquares += sums[0] + sums[1];
+    level.count += i;
+    levelKernelScalar(samples + i, count - i, level);
+}
+
+static void scaleKernelSSE(float* samples, size_t count, float gain) {
+    __m128 g = _mm_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), g));
+    }
+    scaleKernelScalar(samples + i, count - i, gain);
+}
+
+__attribute__((target("avx2,fma")))
+static void levelKernelAVX2(const float* samples, size_t count, LevelSums& level) {
+    __m256 lo = _mm256_set1_ps(level.minSample);
+    __m256 hi = _mm256_set1_ps(level.maxSample);
+    __m256d squares0 = _mm256_setzero_pd();
+    __m256d squares1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(samples + i);
+        lo = _mm256_min_ps(lo, x);
+        hi = _mm256_max_ps(hi, x);
+        __m256d x0 = _mm256_cvtps_pd(_mm256_castps256_ps128(x));
+        __m256d x1 = _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1));
+        squares0 = _mm256_fmadd_pd(x0, x0, squares0);
+        squares1 = _mm256_fmadd_pd(x1, x1, squares1);
+    }
+
+    float los[8], his[8];
+    double sums[4];
+    _mm256_storeu_ps(los, lo);
+    _mm256_storeu_ps(his, hi);
+    _mm256_storeu_pd(sums, _mm256_add_pd(squares0, squares1));
+    for (int k = 0; k < 8; ++k) {
+        level.minSample = min(level.minSample, los[k]);
+        level.maxSample = max(level.maxSample, his[k]);
+    }
+    level.sumSquares += (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    level.count += i;
+    levelKernelSSE(samples + i, count - i, level);
+}
+
+__attribute__((target("avx2")))
+static void scaleKernelAVX2(float* samples, size_t count, float gain) {
+    __m256 g = _mm256_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), g));
+    }
+    scaleKernelSSE(samples + i, count - i, gain);
+}
+
+#endif
+
+// Follows the FIR kernel choice, so one FILTER_SIMD setting covers both.
+static LevelKernel selectLevelKernel() {
+#if defined(__x86_64__) || defined(__i386__)
+    FIRKernel fir = selectFIRKernel();
+    if (fir == firKernelAVX2) {
+        return levelKernelAVX2;
+    }
+    if (fir == firKernelSSE) {
+        return levelKernelSSE;
+    }
+#endif
+    return levelKernelScalar;
+}
+
+static ScaleKernel selectScaleKernel() {
+#if defined(__x86_64__) || defined(__i386__)
+    FIRKernel fir = selectFIRKernel();
+    if (fir == firKernelAVX2) {
+        return scaleKernelAVX2;
+    }
+    if (fir == firKernelSSE) {
+        return scaleKernelSSE;
+    }
+#endif
+    return scaleKernelScalar;
+}
+
+LevelSums emptyLevel() {
+    LevelSums level;
+    level.minSample = INFINITY;
+    level.maxSample = -INFINITY;
+    level.sumSquares = 0.0;
+    level.count = 0;
+    return level;
+}
+
+void combineLevel(LevelSums& into, const LevelSums& other) {
+    into.minSample = min(into.minSample, other.minSample);
+    into.maxSample = max(into.maxSample, other.maxSample);
+    into.sumSquares += other.sumSquares;
+    into.count += other.count;
+}
+
+float signedPeak(const LevelSums& level) {
+    if (level.count == 0) {
+        return 0.0f;
+    }
+    return -level.minSample > level.maxSample ? level.minSample : level.maxSample;
+}
+
+float rmsDb(const LevelSums& level) {
+    if (level.count == 0 || level.sumSquares <= 0.0) {
+        return -INFINITY;
+    }
+    return 10.0f * log10(level.sumSquares / level.count);
+}
+
+LevelSums measureLevel(const float* samples, size_t count) {
+    static const LevelKernel kernel = selectLevelKernel();
+
+    // Phase one: one partial per chunk. Phase two: combine them in order.
+    size_t chunks = (count + LEVEL_GRAIN - 1) / LEVEL_GRAIN;
+    vector<LevelSums> partials(chunks, emptyLevel());
+    globalPool().parallelFor(0, chunks, [&](size_t first, size_t last) {
+        for (size_t c = first; c < last; ++c) {
+            size_t begin = c * LEVEL_GRAIN;
+            kernel(samples + begin, min(count, begin + LEVEL_GRAIN) - begin, partials[c]);
+        }
+    });
+
+    LevelSums total = emptyLevel();
+    for (const LevelSums& partial : partials) {
+        combineLevel(total, partial);
+    }
+    return total;
+}
+
+void scaleAudio(vector<float>& data, float gain) {
+    static const ScaleKernel kernel = selectScaleKernel();
+    float* samples = data.data();
+    size_t count = data.size();
+    globalPool().parallelFor(0, count, [&](size_t first, size_t last) {
+        kernel(samples + first, last - first, gain);
+    }, LEVEL_GRAIN);
+}
+
+NormalizeTarget parseNormalizeTarget(const string& spec) {
+    NormalizeTarget target;
+    string mode = spec.substr(0, spec.find(':'));
+    if (mode == "peak") {
+        target.mode = NORMALIZE_PEAK;
+        target.targetDb = 0.0f;
+    } else if (mode == "rms") {
+        target.mode = NORMALIZE_RMS;
+        target.targetDb = -20.0f;
+    } else if (mode == "lufs") {
+        target.mode = NORMALIZE_LOUDNESS;
+        target.targetDb = -23.0f;
+    } else {
+        cerr << "Error: unknown normalization mode '" << spec << "' (expected peak, rms or lufs)" << endl;
+        exit(1);
+    }
+    if (mode.size() < spec.size()) {
+        target.targetDb = atof(spec.c_str() + mode.size() + 1);
+    }
+    return target;
+}
+
+float gatedLoudness(const vector<float>& data, int sampleRate) {
+    static const LevelKernel kernel = selectLevelKernel();
+
+    // 100 ms steps; each 400 ms block is four neighbouring steps.
+    size_t step = max(1, sampleRate / 10);
+    size_t steps = data.size() / step;
+    if (steps < 4) {
+        LevelSums level = measureLevel(data.data(), data.size());
+        return level.count == 0 ? -INFINITY : -0.691f + rmsDb(level);
+    }
+
+    vector<LevelSums> stepLevels(steps, emptyLevel());
+    globalPool().parallelFor(0, steps, [&](size_t first, size_t last) {
+        for (size_t s = first; s < last; ++s) {
+            kernel(data.data() + s * step, step, stepLevels[s]);
+        }
+    });
+
+    size_t blocks = steps - 3;
+    vector<double> blockPower(blocks);
+    for (size_t j = 0; j < blocks; ++j) {
+        double sum = 0.0;
+        for (size_t s = j; s < j + 4; ++s) {
+            sum += stepLevels[s].sumSquares;
+        }
+        blockPower[j] = sum / (4 * step);
+    }
+
+    auto loudness = [](double power) { return -0.691 + 10.0 * log10(power); };
+    auto gatedMean = [&](double gate) {
+        double sum = 0.0;
+        size_t kept = 0;
+        for (double power : blockPower) {
+            if (power > 0.0 && loudness(power) > gate) {
+                sum += power;
+                ++kept;
+            }
+        }
+        return kept == 0 ? 0.0 : sum / kept;
+    };
+
+    double absoluteGated = gatedMean(-70.0);
+    if (absoluteGated <= 0.0) {
+        return -INFINITY;
+    }
+    double relativeGated = gatedMean(loudness(absoluteGated) - 10.0);
+    return relativeGated <= 0.0 ? -INFINITY : loudness(relativeGated);
+}
+
+float normalizationGain(const vector<float>& data, int sampleRate, const NormalizeTarget& target) {
+    float targetLinear = pow(10.0f, target.targetDb / 20.0f);
+    if (target.mode == NORMALIZE_PEAK) {
+        LevelSums level = measureLevel(data.data(), data.size());
+        float peak = signedPeak(level);
+        if (level.count > 0 && -level.minSample == level.maxSample) {
+            // Both signs reach the peak; the old search kept whichever came first.
+            peak = *find_if(data.begin(), data.end(), [&](float x) { return std::abs(x) == level.maxSample; });
+        }
+        return peak > 0 ? targetLinear / peak : 1.0f;
+    }
+
+    float measured = target.mode == NORMALIZE_RMS ? rmsDb(measureLevel(data.data(), data.size()))
+                                                  : gatedLoudness(data, sampleRate);
+    if (std::isinf(measured)) {
+        return 1.0f;
+    }
+    return pow(10.0f, (target.targetDb - measured) / 20.0f);
+}
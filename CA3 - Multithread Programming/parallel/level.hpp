@@ -0,0 +1,60 @@
+#ifndef LEVEL_HPP
+#define LEVEL_HPP
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+// Partial level statistics of a run of samples. Partials of neighbouring
+// runs combine with combineLevel, so a reduction can be split any way.
+struct LevelSums {
+    float minSample;
+    float maxSample;
+    double sumSquares;
+    size_t count;
+};
+
+LevelSums emptyLevel();
+void combineLevel(LevelSums& into, const LevelSums& other);
+
+// The sample with the largest magnitude, keeping its sign (the positive one
+// on a tie), and the RMS level in dBFS.
+float signedPeak(const LevelSums& level);
+float rmsDb(const LevelSums& level);
+
+// Min, max and sum of squares of `count` samples, split into chunks on the
+// pool; each worker runs the widest SIMD kernel the FIR kernel selection
+// picked (FILTER_SIMD applies here too).
+LevelSums measureLevel(const float* samples, size_t count);
+
+// Multiplies every sample by `gain` on the pool, with the same kernels.
+void scaleAudio(std::vector<float>& data, float gain);
+
+enum NormalizeMode {
+    NORMALIZE_PEAK,
+    NORMALIZE_RMS,
+    NORMALIZE_LOUDNESS
+};
+
+// What normalizeAudio aims for: the peak, the RMS level, or the gated
+// loudness, each at targetDb (dBFS; LUFS-style for loudness).
+struct NormalizeTarget {
+    NormalizeMode mode;
+    float targetDb;
+};
+
+// Parses "peak[:dB]", "rms[:dB]" or "lufs[:dB]". The defaults are 0 dBFS
+// peak, -20 dBFS RMS and -23 LUFS.
+NormalizeTarget parseNormalizeTarget(const std::string& spec);
+
+// BS.1770-style integrated loudness: mean square over 400 ms blocks with
+// 75% overlap, an absolute gate at -70 and a relative gate 10 below the
+// gated mean. No K-weighting pre-filter is applied, so it reads as a gated
+// RMS level rather than true LUFS.
+float gatedLoudness(const std::vector<float>& data, int sampleRate);
+
+// Gain that brings `data` to the target. Peak mode keeps the old rule of
+// leaving the signal alone unless its largest-magnitude sample is positive.
+float normalizationGain(const std::vector<float>& data, int sampleRate, const NormalizeTarget& target);
+
+#endif
@@ -6,352 +6,706 @@
 #include <cmath>
 #include <algorithm>
 #include <chrono>
-#include <pthread.h>
+#include <cstdlib>
+#include <functional>
+#include <cctype>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "thread_pool.hpp"
+#include "verify.hpp"
+#include "fir_kernels.hpp"
+#include "stft.hpp"
+#include "../common/fft.hpp"
+#include "../common/stream.hpp"
+#include "../common/channels.hpp"
+#include "../common/design.hpp"
+#include "pipeline.hpp"
+#include "wav_io.hpp"
+#include "fused.hpp"
+#include "level.hpp"
+#include "batch.hpp"
+#include "sos_lanes.hpp"
+#include "realtime.hpp"
+#include "memory.hpp"
 
 using namespace std;
 using namespace std::chrono;
 
-struct BandpassFilterArgs {
-    vector<float>* data;
-    int sampleRate;
-    float lowCutoff;
-    float highCutoff;
-    size_t start;
-    size_t end;
-};
-
-struct NotchFilterArgs {
-    vector<float>* data;
-    int sampleRate;
-    float notchFrequency;
-    int n;
-    size_t start;
-    size_t end;
-};
-
 struct FIRFilterArgs {
-    vector<float>* data;
+    const vector<float>* input;
+    vector<float>* output;
     const vector<float>* coefficients;
+    FIRKernel kernel;
     size_t start;
     size_t end;
 };
 
 struct IIRFilterArgs {
-    vector<float>* data;
+    const vector<float>* input;
+    vector<float>* output;
     const vector<float>* b;
     const vector<float>* a;
+    const double* initialState;
     size_t start;
     size_t end;
 };
 
-struct ReadArgs {
-    const std::string* inputFile;
-    vector<float>* data;
-    size_t start;
-    size_t end;
-    SF_INFO fileInfo;
-};
-
-struct WriteArgs {
-    const std::string* outputFile;
-    const vector<float>* data;
-    size_t start;
-    size_t end;
-    SF_INFO fileInfo;
-};
-
-
+void applyBandpassFilter(vector<float>& data, int sampleRate, float lowCutoff, float highCutoff) {
+    StageScope stage("bandpass");
+    applySpectralFilter(data, bandpassGains(sampleRate, STFT_FRAME_SIZE, lowCutoff, highCutoff));
+}
 
+void applyNotchFilter(vector<float>& data, int sampleRate, float notchFrequency, int n) {
+    StageScope stage("notch");
+    applySpectralFilter(data, notchGains(sampleRate, STFT_FRAME_SIZE, notchFrequency, n));
+}
 
-void* applyBandpassFilterSegment(void* args) {
-    BandpassFilterArgs* filterArgs = (BandpassFilterArgs*)args;
-    vector<float>* data = filterArgs->data;
-    int sampleRate = filterArgs->sampleRate;
-    float lowCutoff = filterArgs->lowCutoff;
-    float highCutoff = filterArgs->highCutoff;
+// Two passes on the pool: a SIMD level reduction for the gain, then a SIMD
+// multiply by it. One gain covers all channels, so `sampleRate` is the
+// interleaved rate (frame rate * channels).
+void normalizeAudio(std::vector<float>& data, int sampleRate, const NormalizeTarget& target) {
+    StageScope stage("normalize");
+    float gain = normalizationGain(data, sampleRate, target);
+    if (gain != 1.0f) {
+        scaleAudio(data, gain);
+    }
+}
+// Every output reads the M-1 input samples before it (the halo). Segments
+// past the first M-1 samples take their halo straight from the read-only
+// input; the start of the signal is served from a small zero-padded copy so
+// the kernel itself never has to test n >= k.
+void* applyFIRFilterSegment(void* args) {
+    FIRFilterArgs* filterArgs = (FIRFilterArgs*)args;
+    const vector<float>* input = filterArgs->input;
+    vector<float>* output = filterArgs->output;
+    const vector<float>* coefficients = filterArgs->coefficients;
+    FIRKernel kernel = filterArgs->kernel;
     size_t start = filterArgs->start;
     size_t end = filterArgs->end;
+    size_t M = coefficients->size();
+    size_t halo = M - 1;
+
+    size_t headEnd = min(end, max(start, halo));
+    if (start < headEnd) {
+        vector<float>& padded = threadScratch().samples;
+        padded.assign(halo + headEnd, 0.0f);
+        std::copy(input->begin(), input->begin() + headEnd, padded.begin() + halo);
+        kernel(padded.data() + halo + start, output->data() + start, headEnd - start, coefficients->data(), M);
+    }
 
-    float deltaF = highCutoff - lowCutoff;
-
-    for (size_t i = start; i < end; ++i) {
-        float f = static_cast<float>(i) / data->size() * sampleRate;
-        if (f < lowCutoff || f > highCutoff) {
-            (*data)[i] = 0.0f;
-        } else {
-            (*data)[i] *= (f * f) / (f * f + deltaF * deltaF);
-        }
+    if (headEnd < end) {
+        kernel(input->data() + headEnd, output->data() + headEnd, end - headEnd, coefficients->data(), M);
     }
 
     return NULL;
 }
 
-void applyBandpassFilter(vector<float>& data, int sampleRate, float lowCutoff, float highCutoff) {
-    int numThreads = 4;
-    pthread_t threads[numThreads];
-    BandpassFilterArgs args[numThreads];
-    size_t segmentSize = data.size() / numThreads;
-
-    for (int i = 0; i < numThreads; ++i) {
-        args[i] = {&data, sampleRate, lowCutoff, highCutoff, i * segmentSize, (i + 1) * segmentSize};
-        if (i == numThreads - 1) {
-            args[i].end = data.size();
-        }
-        pthread_create(&threads[i], NULL, applyBandpassFilterSegment, &args[i]);
+void applyFIRFilter(vector<float>& data, const vector<float>& coefficients) {
+    static const FIRKernel genericKernel = selectFIRKernel();
+    StageScope stage("fir");
+    if (coefficients.empty()) {
+        std::fill(data.begin(), data.end(), 0.0f);
+        return;
     }
 
-    for (int i = 0; i < numThreads; ++i) {
-        pthread_join(threads[i], NULL);
+    vector<float> filteredData(data.size());
+    releaseForFirstTouch(filteredData);
+    FIRKernel kernel = selectFIRKernel(coefficients.size());
+    size_t fftThreshold = genericKernel == firKernelScalar ? FFT_CONVOLUTION_MIN_TAPS : FFT_CONVOLUTION_MIN_TAPS_SIMD;
+    if (coefficients.size() >= fftThreshold) {
+        OverlapSaveConvolver convolver(coefficients);
+        size_t blockSize = convolver.blockSize();
+        size_t numBlocks = (data.size() + blockSize - 1) / blockSize;
+        globalPool().parallelFor(0, numBlocks, [&](size_t first, size_t last) {
+            vector<complex<float>>& scratch = threadScratch().spectrum;
+            for (size_t block = first; block < last; ++block) {
+                size_t start = block * blockSize;
+                convolver.convolveBlock(data, start, min(data.size(), start + blockSize), filteredData.data(), scratch);
+            }
+        });
+        data.swap(filteredData);
+        return;
     }
+
+    globalPool().parallelFor(0, data.size(), [&](size_t start, size_t end) {
+        FIRFilterArgs args = {&data, &filteredData, &coefficients, kernel, start, end};
+        applyFIRFilterSegment(&args);
+    });
+    data.swap(filteredData);
 }
 
-void* applyNotchFilterSegment(void* args) {
-    NotchFilterArgs* filterArgs = (NotchFilterArgs*)args;
-    vector<float>* data = filterArgs->data;
-    int sampleRate = filterArgs->sampleRate;
-    float notchFrequency = filterArgs->notchFrequency;
-    int n = filterArgs->n;
+// Zero-state pass: filters [start, end) as if every output before `start`
+// were zero. The input is only read, so the FIR part can look back across
+// the segment boundary without racing the other workers.
+void* applyIIRFilterSegment(void* args) {
+    IIRFilterArgs* filterArgs = (IIRFilterArgs*)args;
+    const vector<float>* input = filterArgs->input;
+    vector<float>* output = filterArgs->output;
+    const vector<float>* b = filterArgs->b;
+    const vector<float>* a = filterArgs->a;
     size_t start = filterArgs->start;
     size_t end = filterArgs->end;
+    size_t P = b->size();
+    size_t Q = a->size();
 
-    for (size_t i = start; i < end; ++i) {
-        float f = static_cast<float>(i) / data->size() * sampleRate;
-        float H_f = 1.0f / (1.0f + std::pow((notchFrequency / f), 2 * n));
-        (*data)[i] *= H_f;
+    for (size_t n = start; n < end; ++n) {
+        float sum = 0.0f;
+        size_t taps = min(P, n + 1);
+        for (size_t i = 0; i < taps; ++i) {
+            sum += (*b)[i] * (*input)[n - i];
+        }
+        size_t feedback = min(Q - 1, n - start);
+        for (size_t j = 1; j <= feedback; ++j) {
+            sum -= (*a)[j] * (*output)[n - j];
+        }
+        (*output)[n] = sum;
     }
 
     return NULL;
 }
 
-void applyNotchFilter(vector<float>& data, int sampleRate, float notchFrequency, int n) {
-    int numThreads = 8;
-    pthread_t threads[numThreads];
-    NotchFilterArgs args[numThreads];
-    size_t segmentSize = data.size() / numThreads;
-
-    for (int i = 0; i < numThreads; ++i) {
-        args[i] = {&data, sampleRate, notchFrequency, n, i * segmentSize, (i + 1) * segmentSize};
-        if (i == numThreads - 1) {
-            args[i].end = data.size();
+// Adds the response to the true initial state (the last outputs of the
+// previous segment, newest first) on top of the zero-state pass above.
+void* applyIIRStateCorrectionSegment(void* args) {
+    IIRFilterArgs* filterArgs = (IIRFilterArgs*)args;
+    vector<float>* output = filterArgs->output;
+    const vector<float>* a = filterArgs->a;
+    const double* initialState = filterArgs->initialState;
+    size_t start = filterArgs->start;
+    size_t end = filterArgs->end;
+    size_t order = a->size() - 1;
+
+    vector<double>& history = threadScratch().state;
+    history.assign(initialState, initialState + order);
+    for (size_t n = start; n < end; ++n) {
+        double h = 0.0;
+        for (size_t j = 1; j <= order; ++j) {
+            h -= (*a)[j] * history[j - 1];
+        }
+        for (size_t j = order - 1; j > 0; --j) {
+            history[j] = history[j - 1];
         }
-        pthread_create(&threads[i], NULL, applyNotchFilterSegment, &args[i]);
+        history[0] = h;
+        (*output)[n] += h;
     }
 
-    for (int i = 0; i < numThreads; ++i) {
-        pthread_join(threads[i], NULL);
-    }
+    return NULL;
 }
 
-void* readWavFileSegment(void* args) {
-    ReadArgs* readArgs = (ReadArgs*)args;
-    const std::string* inputFile = readArgs->inputFile;
-    vector<float>* data = readArgs->data;
-    size_t start = readArgs->start;
-    size_t end = readArgs->end;
-    SF_INFO fileInfo = readArgs->fileInfo;
-
-    SNDFILE* inFile = sf_open(inputFile->c_str(), SFM_READ, &fileInfo);
-    if (!inFile) {
-        std::cerr << "Error opening input file: " << sf_strerror(NULL) << std::endl;
-        exit(1);
+// Companion matrix of the feedback recursion raised to `steps`: maps the
+// state (y[n-1], ..., y[n-order]) to the state `steps` samples later when
+// the input is zero.
+vector<double> iirStateTransition(const vector<float>& a, size_t steps) {
+    size_t order = a.size() - 1;
+    vector<double> result(order * order, 0.0);
+    vector<double> base(order * order, 0.0);
+    for (size_t i = 0; i < order; ++i) {
+        result[i * order + i] = 1.0;
+        base[i] = -a[i + 1];
+        if (i > 0) {
+            base[i * order + i - 1] = 1.0;
+        }
     }
 
-    sf_seek(inFile, start / fileInfo.channels, SEEK_SET);
-    sf_readf_float(inFile, data->data() + start, (end - start) / fileInfo.channels);
-    sf_close(inFile);
+    auto multiply = [order](const vector<double>& x, const vector<double>& y) {
+        vector<double> product(order * order, 0.0);
+        for (size_t i = 0; i < order; ++i) {
+            for (size_t k = 0; k < order; ++k) {
+                for (size_t j = 0; j < order; ++j) {
+                    product[i * order + j] += x[i * order + k] * y[k * order + j];
+                }
+            }
+        }
+        return product;
+    };
 
-    return NULL;
+    while (steps > 0) {
+        if (steps & 1) {
+            result = multiply(base, result);
+        }
+        base = multiply(base, base);
+        steps >>= 1;
+    }
+    return result;
 }
 
+// Block-parallel IIR. Each segment is first filtered from a zero state in
+// parallel; a short serial scan then carries the feedback state across the
+// segments (state_k = tail_k + A^len * state_{k-1}), and a second parallel
+// pass adds each segment's response to its incoming state. The result
+// matches the serial recursion up to float rounding.
+void applyIIRFilter(vector<float>& data, const vector<float>& b, const vector<float>& a) {
+    StageScope stage("iir");
+    size_t order = a.size() - 1;
+    vector<float> filteredData(data.size(), 0.0f);
+    releaseForFirstTouch(filteredData);
+    size_t threads = globalPool().concurrency();
+    size_t segmentSize = max((data.size() + threads - 1) / threads, order + 1);
+
+    globalPool().parallelFor(0, data.size(), [&](size_t start, size_t end) {
+        IIRFilterArgs args = {&data, &filteredData, &b, &a, NULL, start, end};
+        applyIIRFilterSegment(&args);
+    }, segmentSize);
+
+    if (order == 0 || data.size() <= segmentSize) {
+        data.swap(filteredData);
+        return;
+    }
 
-void readWavFile(const std::string& inputFile, std::vector<float>& data, SF_INFO& fileInfo) {
-    SNDFILE* inFile = sf_open(inputFile.c_str(), SFM_READ, &fileInfo);
-    if (!inFile) {
-        std::cerr << "Error opening input file: " << sf_strerror(NULL) << std::endl;
-        exit(1);
+    size_t numSegments = (data.size() + segmentSize - 1) / segmentSize;
+    vector<double> transition = iirStateTransition(a, segmentSize);
+    vector<double> states(numSegments * order, 0.0);
+
+    for (size_t k = 1; k < numSegments; ++k) {
+        size_t segmentEnd = k * segmentSize;
+        const double* previous = &states[(k - 1) * order];
+        double* current = &states[k * order];
+        for (size_t i = 0; i < order; ++i) {
+            double value = filteredData[segmentEnd - 1 - i];
+            for (size_t j = 0; j < order; ++j) {
+                value += transition[i * order + j] * previous[j];
+            }
+            current[i] = value;
+        }
     }
 
-    data.resize(fileInfo.frames * fileInfo.channels);
-    sf_close(inFile);
+    globalPool().parallelFor(segmentSize, data.size(), [&](size_t start, size_t end) {
+        IIRFilterArgs args = {&data, &filteredData, &b, &a, &states[(start / segmentSize) * order], start, end};
+        applyIIRStateCorrectionSegment(&args);
+    }, segmentSize);
 
-    int numThreads = 8;
-    pthread_t threads[numThreads];
-    ReadArgs args[numThreads];
-    size_t segmentSize = data.size() / numThreads;
+    data.swap(filteredData);
+}
 
-    for (int i = 0; i < numThreads; ++i) {
-        args[i] = {&inputFile, &data, i * segmentSize, (i + 1) * segmentSize, fileInfo};
-        if (i == numThreads - 1) {
-            args[i].end = data.size();
-        }
-        pthread_create(&threads[i], NULL, readWavFileSegment, &args[i]);
+// Splits interleaved data into one buffer per channel, hands all of them to
+// `filter` and interleaves the results back. Mono data is moved in and out
+// without a copy.
+void applyAcrossChannels(std::vector<float>& data, int channels, const std::function<void(PlanarAudio&)>& filter) {
+    PlanarAudio planar;
+    if (channels <= 1) {
+        planar.resize(1);
+        planar[0].swap(data);
+        filter(planar);
+        data.swap(planar[0]);
+        return;
     }
 
-    for (int i = 0; i < numThreads; ++i) {
-        pthread_join(threads[i], NULL);
-    }
-}
+    const size_t frameGrain = 1 << 14;
+    size_t frames = data.size() / channels;
+    resizePlanar(planar, channels, frames);
+    globalPool().parallelFor(0, frames, [&](size_t first, size_t last) {
+        deinterleaveRange(data, planar, first, last);
+    }, frameGrain);
 
+    filter(planar);
 
-void* writeWavFileSegment(void* args) {
-    WriteArgs* writeArgs = (WriteArgs*)args;
-    const std::string* outputFile = writeArgs->outputFile;
-    const vector<float>* data = writeArgs->data;
-    size_t start = writeArgs->start;
-    size_t end = writeArgs->end;
-    SF_INFO fileInfo = writeArgs->fileInfo;
+    globalPool().parallelFor(0, frames, [&](size_t first, size_t last) {
+        interleaveRange(planar, data, first, last);
+    }, frameGrain);
+}
 
-    SNDFILE* outFile = sf_open(outputFile->c_str(), SFM_WRITE, &fileInfo);
-    if (!outFile) {
-        std::cerr << "Error opening output file: " << sf_strerror(NULL) << std::endl;
-        exit(1);
+// Runs `filter` on every channel separately, the channels side by side on
+// the pool.
+void applyPerChannel(std::vector<float>& data, int channels, const std::function<void(std::vector<float>&)>& filter) {
+    if (channels <= 1) {
+        filter(data);
+        return;
     }
 
-    sf_seek(outFile, start / fileInfo.channels, SEEK_SET);
-    sf_writef_float(outFile, data->data() + start, (end - start) / fileInfo.channels);
-    sf_close(outFile);
+    applyAcrossChannels(data, channels, [&](PlanarAudio& planar) {
+        globalPool().parallelFor(0, planar.size(), [&](size_t first, size_t last) {
+            for (size_t c = first; c < last; ++c) {
+                filter(planar[c]);
+            }
+        }, 1);
+    });
+}
 
-    return NULL;
+// All channels of the file through one SOS cascade, packed into SIMD lanes.
+void applySOSFilterChannels(PlanarAudio& planar, const SOSCascade& cascade) {
+    std::vector<std::vector<float>*> signals;
+    for (std::vector<float>& channel : planar) {
+        signals.push_back(&channel);
+    }
+    applySOSFilterLanes(signals, cascade);
 }
 
+// One output of the fan-out graph: a private copy of the decoded input,
+// optionally normalised, run through `apply` channel by channel and written
+// to `outputFile`. Branches that filter the channels together set
+// `applyChannels` instead.
+// The filtered samples stay in `output` for --verify.
+struct FilterBranch {
+    std::string name;
+    std::string outputFile;
+    bool normalize;
+    std::function<void(std::vector<float>&)> apply;
+    std::vector<float> output = {};
+    std::function<void(PlanarAudio&)> applyChannels = {};
+    long long filterUs = 0;
+    long long writeUs = 0;
+};
+
+// Runs every branch on the same decoded input, side by side on the pool.
+// Each branch's kernels use the pool as well, so cores left idle by one
+// branch's serial parts are picked up by the others.
+void runFilterGraph(const std::vector<float>& input, const SF_INFO& fileInfo, std::vector<FilterBranch>& branches,
+                    const NormalizeTarget& normalizeTarget) {
+    globalPool().parallelFor(0, branches.size(), [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            FilterBranch& branch = branches[i];
+            branch.output = input;
+            if (branch.normalize) {
+                normalizeAudio(branch.output, fileInfo.samplerate * fileInfo.channels, normalizeTarget);
+            }
 
-void writeWavFile(const std::string& outputFile, const std::vector<float>& data, SF_INFO& fileInfo) {
-    int numThreads = 8;
-    pthread_t threads[numThreads];
-    WriteArgs args[numThreads];
-    size_t segmentSize = data.size() / numThreads;
+            auto startFilter = high_resolution_clock::now();
+            if (branch.applyChannels) {
+                applyAcrossChannels(branch.output, fileInfo.channels, branch.applyChannels);
+            } else {
+                applyPerChannel(branch.output, fileInfo.channels, branch.apply);
+            }
+            auto endFilter = high_resolution_clock::now();
 
-    for (int i = 0; i < numThreads; ++i) {
-        args[i] = {&outputFile, &data, i * segmentSize, (i + 1) * segmentSize, fileInfo};
-        if (i == numThreads - 1) {
-            args[i].end = data.size();
+            SF_INFO outInfo = fileInfo;
+            writeWavFile(branch.outputFile, branch.output, outInfo);
+            auto endWrite = high_resolution_clock::now();
+
+            branch.filterUs = duration_cast<microseconds>(endFilter - startFilter).count();
+            branch.writeUs = duration_cast<microseconds>(endWrite - endFilter).count();
         }
-        pthread_create(&threads[i], NULL, writeWavFileSegment, &args[i]);
-    }
+    }, 1);
+}
 
-    for (int i = 0; i < numThreads; ++i) {
-        pthread_join(threads[i], NULL);
-    }
+// The four filters of every run, writing to outputFiles[0..3]: the
+// normalised band-pass, then notch, FIR and IIR on the raw input.
+std::vector<FilterBranch> makeFilterBranches(int sampleRate, const std::vector<std::string>& outputFiles,
+                                             const std::vector<float>& firCoefficients,
+                                             const std::vector<float>& b, const std::vector<float>& a) {
+    return {
+        {"Band-pass", outputFiles[0], true, [=](std::vector<float>& data) { applyBandpassFilter(data, sampleRate, 300.0f, 3000.0f); }},
+        {"Notch", outputFiles[1], false, [=](std::vector<float>& data) { applyNotchFilter(data, sampleRate, 50.0f, 2); }},
+        {"FIR", outputFiles[2], false, [=](std::vector<float>& data) { applyFIRFilter(data, firCoefficients); }},
+        {"IIR", outputFiles[3], false, [=](std::vector<float>& data) { applyIIRFilter(data, b, a); }},
+    };
 }
 
+// Chains for the streaming modes, in the order of the output files: the
+// normalised band-pass, then notch, FIR and IIR on the raw input, as in
+// the in-memory graph.
+// Only peak normalisation is available here; the other targets need the
+// whole signal in memory.
+std::vector<FilterChain> buildStreamChains(const std::string& inputFile, size_t blockFrames, const NormalizeTarget& normalizeTarget,
+                                           const std::vector<float>& firCoefficients) {
+    if (normalizeTarget.mode != NORMALIZE_PEAK) {
+        std::cerr << "Error: the streaming modes only support peak normalization" << std::endl;
+        exit(1);
+    }
+    SF_INFO streamInfo = readStreamInfo(inputFile);
+    int sampleRate = streamInfo.samplerate;
+    float peak = streamPeakSample(inputFile, blockFrames);
+    float targetLinear = std::pow(10.0f, normalizeTarget.targetDb / 20.0f);
+
+    float gain = peak > 0 ? targetLinear / peak : 1.0f;
+    int channels = streamInfo.channels;
+
+    std::vector<FilterChain> chains(4);
+    addPerChannel(chains[0], channels, [=](FilterChain& chain) {
+        chain.add(new GainStage(gain));
+        chain.add(new SpectralStage(bandpassGains(sampleRate, STFT_FRAME_SIZE, 300.0f, 3000.0f)));
+    });
+    addPerChannel(chains[1], channels, [=](FilterChain& chain) {
+        chain.add(new SpectralStage(notchGains(sampleRate, STFT_FRAME_SIZE, 50.0f, 2)));
+    });
+    addPerChannel(chains[2], channels, [&](FilterChain& chain) {
+        chain.add(new FIRStage(firCoefficients));
+    });
+    addPerChannel(chains[3], channels, [](FilterChain& chain) {
+        chain.add(new IIRStage({0.1, 0.15, 0.5, 0.15, 0.1}, {1.0, -0.5, 0.25}));
+    });
+    return chains;
+}
 
-void normalizeAudio(std::vector<float>& data) {
-    float maxAmplitude = *std::max_element(data.begin(), data.end(), [](float a, float b) { return std::abs(a) < std::abs(b); });
-    if (maxAmplitude > 0) {
-        for (auto& sample : data) {
-            sample /= maxAmplitude;
+// Splits a --fused spec such as "normalize,bandpass,notch,fir" into its steps.
+std::vector<std::string> parseFusedSpec(const std::string& spec) {
+    std::vector<std::string> steps;
+    size_t begin = 0;
+    while (begin <= spec.size()) {
+        size_t comma = spec.find(',', begin);
+        if (comma == std::string::npos) {
+            comma = spec.size();
+        }
+        std::string step = spec.substr(begin, comma - begin);
+        if (step != "normalize" && step != "bandpass" && step != "notch" && step != "fir") {
+            std::cerr << "Error: unknown fused step '" << step << "' (expected normalize, bandpass, notch or fir)" << std::endl;
+            exit(1);
         }
+        if (step == "normalize" && !steps.empty()) {
+            std::cerr << "Error: normalize can only be the first fused step" << std::endl;
+            exit(1);
+        }
+        steps.push_back(step);
+        begin = comma + 1;
     }
+    return steps;
 }
-void* applyFIRFilterSegment(void* args) {
-    FIRFilterArgs* filterArgs = (FIRFilterArgs*)args;
-    vector<float>* data = filterArgs->data;
-    const vector<float>* coefficients = filterArgs->coefficients;
-    size_t start = filterArgs->start;
-    size_t end = filterArgs->end;
-    int M = coefficients->size();
-    
-    vector<float> filteredData(data->size(), 0.0f);
 
-    for (size_t n = start; n < end; ++n) {
-        for (int k = 0; k < M; ++k) {
-            if (n >= k) {
-                filteredData[n] += (*coefficients)[k] * (*data)[n - k];
+// The fused steps use the same parameters as the separate branches. The
+// normalise gain is taken from the whole signal (all channels) up front,
+// since it is the one step that cannot be decided tile by tile; it has to
+// come first.
+void applyFusedSteps(std::vector<float>& data, int sampleRate, const std::vector<std::string>& steps,
+                     const std::vector<float>& firCoefficients, float gain) {
+    applyFusedChain(data, [&](FilterChain& chain) {
+        for (const std::string& step : steps) {
+            if (step == "normalize") {
+                chain.add(new GainStage(gain));
+            } else if (step == "bandpass") {
+                chain.add(new SpectralStage(bandpassGains(sampleRate, STFT_FRAME_SIZE, 300.0f, 3000.0f)));
+            } else if (step == "notch") {
+                chain.add(new SpectralStage(notchGains(sampleRate, STFT_FRAME_SIZE, 50.0f, 2)));
+            } else {
+                chain.add(new FIRStage(firCoefficients));
             }
         }
-    }
+    });
+}
 
-    for (size_t n = start; n < end; ++n) {
-        (*data)[n] = filteredData[n];
+// Lowercase branch name without punctuation ("Band-pass" -> "bandpass"),
+// as used by --filter and the --timings lines.
+std::string branchKey(const std::string& name) {
+    std::string key;
+    for (char c : name) {
+        if (isalnum(static_cast<unsigned char>(c))) {
+            key += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        }
     }
-
-    return NULL;
+    return key;
 }
 
-void applyFIRFilter(vector<float>& data, const vector<float>& coefficients) {
-    int numThreads = 8;
-    pthread_t threads[numThreads];
-    FIRFilterArgs args[numThreads];
-    size_t segmentSize = data.size() / numThreads;
-
-    for (int i = 0; i < numThreads; ++i) {
-        args[i] = {&data, &coefficients, i * segmentSize, (i + 1) * segmentSize};
-        if (i == numThreads - 1) {
-            args[i].end = data.size();
+// Keeps only the branch selected with --filter, so one filter can be timed
+// on its own.
+void selectBranch(std::vector<FilterBranch>& branches, const std::string& key) {
+    std::vector<FilterBranch> selected;
+    for (FilterBranch& branch : branches) {
+        if (branchKey(branch.name) == key) {
+            selected.push_back(std::move(branch));
         }
-        pthread_create(&threads[i], NULL, applyFIRFilterSegment, &args[i]);
     }
-
-    for (int i = 0; i < numThreads; ++i) {
-        pthread_join(threads[i], NULL);
+    if (selected.empty()) {
+        std::cerr << "Error: unknown filter '" << key << "'" << std::endl;
+        exit(1);
     }
+    branches.swap(selected);
 }
 
-void* applyIIRFilterSegment(void* args) {
-    IIRFilterArgs* filterArgs = (IIRFilterArgs*)args;
-    vector<float>* data = filterArgs->data;
-    const vector<float>* b = filterArgs->b;
-    const vector<float>* a = filterArgs->a;
-    size_t start = filterArgs->start;
-    size_t end = filterArgs->end;
-    int P = b->size();
-    int Q = a->size();
-
-    vector<float> filteredData(data->size(), 0.0f);
+// Machine-readable form of the timing report (microseconds), one
+// "timing <what> <us>" line each, for the benchmark harness. A negative
+// graph time means the build has no separate graph timer. The "memory"
+// lines give the heap allocations made while the graph ran and the peak
+// RSS of the run.
+void printTimings(const std::vector<FilterBranch>& branches, long long readUs, long long writeUs, long long graphUs, long long totalUs,
+                  const AllocationStats& graphAllocations) {
+    cout << "timing read " << readUs << endl;
+    cout << "timing write " << writeUs << endl;
+    for (const FilterBranch& branch : branches) {
+        cout << "timing " << branchKey(branch.name) << " " << branch.filterUs << endl;
+    }
+    if (graphUs >= 0) {
+        cout << "timing graph " << graphUs << endl;
+    }
+    cout << "timing total " << totalUs << endl;
+    cout << "memory graph_allocations " << graphAllocations.allocations << endl;
+    cout << "memory graph_allocated_bytes " << graphAllocations.bytes << endl;
+    cout << "memory peak_rss_kb " << peakResidentKb() << endl;
+}
 
-    for (size_t n = start; n < end; ++n) {
-        for (int i = 0; i < P; ++i) {
-            if (n >= i) {
-                filteredData[n] += (*b)[i] * (*data)[n - i];
-            }
-        }
-        for (int j = 1; j < Q; ++j) {
-            if (n >= j) {
-                filteredData[n] -= (*a)[j] * filteredData[n - j];
-            }
+int main(int argc, char* argv[]) {
+    std::string inputFile;
+    bool verify = false;
+    bool stream = false;
+    bool pipeline = false;
+    bool timings = false;
+    std::string filterKey;
+    std::string fusedSpec;
+    std::string sosSpec;
+    std::string realtimeSpec;
+    RealtimeOptions realtime;
+    std::string batchPath;
+    std::string outputDir = "batchOutput";
+    NormalizeTarget normalizeTarget = parseNormalizeTarget("peak");
+    size_t blockFrames = STREAM_BLOCK_FRAMES;
+    size_t firTaps = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            setThreadCount(atoi(argv[++i]));
+        } else if (arg == "--stage-threads" && i + 1 < argc) {
+            setStageThreads(argv[++i]);
+        } else if (arg == "--pin") {
+            setThreadPinning(true);
+        } else if (arg == "--verify") {
+            verify = true;
+        } else if (arg == "--stream") {
+            stream = true;
+        } else if (arg == "--pipeline") {
+            pipeline = true;
+        } else if (arg == "--fused" && i + 1 < argc) {
+            fusedSpec = argv[++i];
+        } else if (arg == "--sos" && i + 1 < argc) {
+            sosSpec = argv[++i];
+        } else if (arg == "--realtime" && i + 1 < argc) {
+            realtimeSpec = argv[++i];
+        } else if (arg == "--rate" && i + 1 < argc) {
+            realtime.sampleRate = atoi(argv[++i]);
+        } else if (arg == "--channels" && i + 1 < argc) {
+            realtime.channels = atoi(argv[++i]);
+        } else if (arg == "--pcm" && i + 1 < argc) {
+            realtime.format = parsePcmFormat(argv[++i]);
+        } else if (arg == "--timings") {
+            timings = true;
+        } else if (arg == "--filter" && i + 1 < argc) {
+            filterKey = argv[++i];
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchPath = argv[++i];
+        } else if (arg == "--output-dir" && i + 1 < argc) {
+            outputDir = argv[++i];
+        } else if (arg == "--normalize" && i + 1 < argc) {
+            normalizeTarget = parseNormalizeTarget(argv[++i]);
+        } else if (arg == "--block-frames" && i + 1 < argc) {
+            blockFrames = std::max(1, atoi(argv[++i]));
+            realtime.blockFrames = blockFrames;
+        } else if (arg == "--fir-taps" && i + 1 < argc) {
+            firTaps = std::max(1, atoi(argv[++i]));
+        } else {
+            inputFile = arg;
         }
     }
 
-    for (size_t n = start; n < end; ++n) {
-        (*data)[n] = filteredData[n];
+    if (inputFile.empty() && batchPath.empty() && realtimeSpec.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--threads N] [--stage-threads fir=N,...] [--pin] [--verify] [--stream | --pipeline] [--block-frames N] [--fused normalize,bandpass,notch,fir] [--sos butterworth|chebyshev,lowpass|highpass|bandpass,ORDER,HZ[,HZ][,RIPPLE_DB]] [--normalize peak|rms|lufs[:dB]] [--fir-taps N] [--filter NAME] [--timings] <../input.wav>" << std::endl;
+        std::cerr << "       " << argv[0] << " [--threads N] [--normalize peak|rms|lufs[:dB]] --batch <directory | manifest> [--output-dir DIR]" << std::endl;
+        std::cerr << "       " << argv[0] << " --realtime fir,iir,notch,sos --rate HZ [--channels N] [--pcm s16|f32] [--block-frames 64-1024] [--sos SPEC] < in.raw > out.raw" << std::endl;
+        return 1;
     }
 
-    return NULL;
-}
+    // --fir-taps swaps the 5-tap FIR for a long low-pass, which takes the
+    // FFT overlap-save path.
+    std::vector<float> firCoefficients = {0.1, 0.15, 0.5, 0.15, 0.1};
+    if (firTaps > 0) {
+        firCoefficients = windowedSincLowpass(firTaps, 0.1f);
+    }
 
-void applyIIRFilter(vector<float>& data, const vector<float>& b, const vector<float>& a) {
-    int numThreads = 4;
-    pthread_t threads[numThreads];
-    IIRFilterArgs args[numThreads];
-    size_t segmentSize = data.size() / numThreads;
-
-    for (int i = 0; i < numThreads; ++i) {
-        args[i] = {&data, &b, &a, i * segmentSize, (i + 1) * segmentSize};
-        if (i == numThreads - 1) {
-            args[i].end = data.size();
+    // Live audio: raw PCM from stdin to stdout on this thread alone, so the
+    // pool is never started. The latency report goes to stderr.
+    if (!realtimeSpec.empty()) {
+        if (realtime.blockFrames == 0) {
+            realtime.blockFrames = REALTIME_DEFAULT_BLOCK_FRAMES;
         }
-        pthread_create(&threads[i], NULL, applyIIRFilterSegment, &args[i]);
-    }
+        if (realtime.sampleRate <= 0 || realtime.channels <= 0) {
+            std::cerr << "Error: --realtime needs --rate and a positive --channels" << std::endl;
+            return 1;
+        }
+        if (realtime.blockFrames < REALTIME_MIN_BLOCK_FRAMES || realtime.blockFrames > REALTIME_MAX_BLOCK_FRAMES) {
+            std::cerr << "Error: --block-frames must be between " << REALTIME_MIN_BLOCK_FRAMES << " and "
+                      << REALTIME_MAX_BLOCK_FRAMES << " in real-time mode" << std::endl;
+            return 1;
+        }
+        realtime.steps = parseRealtimeSpec(realtimeSpec);
+        if (std::find(realtime.steps.begin(), realtime.steps.end(), "sos") != realtime.steps.end()) {
+            if (sosSpec.empty()) {
+                std::cerr << "Error: the sos step needs --sos SPEC" << std::endl;
+                return 1;
+            }
+            realtime.sos = designFromSpec(sosSpec, realtime.sampleRate);
+        }
+        realtime.firCoefficients = firCoefficients;
+        realtime.b = {0.1, 0.15, 0.5, 0.15, 0.1};
+        realtime.a = {1.0, -0.5, 0.25};
 
-    for (int i = 0; i < numThreads; ++i) {
-        pthread_join(threads[i], NULL);
+        LatencyHistogram histogram = runRealtime(realtime, STDIN_FILENO, STDOUT_FILENO);
+        printLatencyReport(std::cerr, histogram);
+        return 0;
     }
-}
-
 
-int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <../input.wav>" << std::endl;
-        return 1;
+    // Start the workers up front so their creation is not billed to the first filter.
+    globalPool();
+
+    if (!batchPath.empty()) {
+        std::vector<std::string> files = listBatchInputs(batchPath);
+        mkdir(outputDir.c_str(), 0755);
+
+        std::vector<float> b = {0.1, 0.15, 0.5, 0.15, 0.1};
+        std::vector<float> a = {1.0, -0.5, 0.25};
+
+        // Outputs are named after the input: clip.wav -> clip_Bandpass.wav etc.
+        std::vector<std::string> stems = batchOutputStems(files);
+        BatchStats stats = runBatch(files, [&](size_t index) -> size_t {
+            SF_INFO fileInfo;
+            std::vector<float> data;
+            std::memset(&fileInfo, 0, sizeof(fileInfo));
+            readWavFile(files[index], data, fileInfo);
+
+            std::string prefix = outputDir + "/" + stems[index];
+            std::vector<FilterBranch> branches = makeFilterBranches(fileInfo.samplerate,
+                {prefix + "_Bandpass.wav", prefix + "_Notch.wav", prefix + "_FIR.wav", prefix + "_IIR.wav"},
+                firCoefficients, b, a);
+            runFilterGraph(data, fileInfo, branches, normalizeTarget);
+            return data.size();
+        });
+
+        double seconds = std::max(stats.seconds, 1e-9);
+        cout << "Worker threads: " << globalPool().size() << endl;
+        cout << "Batch: " << stats.files << " files (" << stats.largeFiles << " split across threads), "
+             << stats.samples << " samples in " << static_cast<long>(stats.seconds * 1000) << " ms" << endl;
+        cout << "Throughput: " << stats.files / seconds << " files/s, " << stats.samples / seconds / 1e6 << " Msamples/s" << endl;
+        AllocationStats allocations = allocationStats();
+        cout << "Heap allocations: " << allocations.allocations << " (" << allocations.bytes / (1 << 20)
+             << " MB), peak resident set " << peakResidentKb() / 1024 << " MB" << endl;
+        return 0;
     }
 
     auto start = high_resolution_clock::now();
 
-    std::string inputFile = argv[1];
     std::string outputFile1 = "outputBandpassParallel.wav";
     std::string outputFile2 = "outputNotchParallel.wav";
     std::string outputFile3 = "outputFIRParallel.wav";
     std::string outputFile4 = "outputIIRParallel.wav";
+    std::string outputFileFused = "outputFusedParallel.wav";
+    std::string outputFileSOS = "outputSOSParallel.wav";
+
+    if (stream || pipeline) {
+        std::vector<FilterChain> chains = buildStreamChains(inputFile, blockFrames, normalizeTarget, firCoefficients);
+        std::vector<std::string> outputFiles = {outputFile1, outputFile2, outputFile3, outputFile4};
+
+        // The four chains are independent, so each block runs them side by side.
+        ChainRunner runner = [](size_t count, const std::function<void(size_t)>& body) {
+            globalPool().parallelFor(0, count, [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; ++i) {
+                    body(i);
+                }
+            }, 1);
+        };
+
+        std::vector<PipelineStats> stats;
+        if (pipeline) {
+            runPipeline(inputFile, chains, outputFiles, blockFrames, PIPELINE_DEPTH, runner, stats);
+        } else {
+            streamFilterChains(inputFile, chains, outputFiles, blockFrames, runner);
+        }
+
+        auto end = high_resolution_clock::now();
+        double wallSeconds = duration<double>(end - start).count();
+        cout << "Worker threads: " << globalPool().size() << endl;
+        for (const PipelineStats& stage : stats) {
+            cout << "Stage " << stage.stage << ": " << stage.blocks << " blocks, "
+                 << stage.samples / std::max(stage.busySeconds, 1e-9) / 1e6 << " Msamples/s busy, "
+                 << stage.busySeconds * 1000 << " ms busy, " << stage.stallSeconds * 1000 << " ms stalled" << endl;
+        }
+        cout << (pipeline ? "Pipelined" : "Streamed") << " all filters in blocks of " << blockFrames << " frames: "
+             << static_cast<long>(wallSeconds * 1000) << " ms" << endl;
+        return 0;
+    }
 
     SF_INFO fileInfo;
     std::vector<float> audioData;
@@ -361,59 +715,151 @@ int main(int argc, char* argv[]) {
     readWavFile(inputFile, audioData, fileInfo);
     auto endRead = high_resolution_clock::now();
 
-    normalizeAudio(audioData);
-
-    auto startBandpass = high_resolution_clock::now();
-    applyBandpassFilter(audioData, fileInfo.samplerate, 300.0f, 3000.0f);
-    auto endBandpass = high_resolution_clock::now();
-
-    auto startWrite = high_resolution_clock::now();
-    writeWavFile(outputFile1, audioData, fileInfo);
-    auto endWrite = high_resolution_clock::now();
+    int sampleRate = fileInfo.samplerate;
+    int channels = fileInfo.channels;
+    std::vector<float> b = {0.1, 0.15, 0.5, 0.15, 0.1};
+    std::vector<float> a = {1.0, -0.5, 0.25};
 
+    std::vector<FilterBranch> branches = makeFilterBranches(sampleRate, {outputFile1, outputFile2, outputFile3, outputFile4},
+                                                            firCoefficients, b, a);
 
-    readWavFile(inputFile, audioData, fileInfo);
+    std::vector<std::string> fusedSteps;
+    float fusedGain = 1.0f;
+    if (!fusedSpec.empty()) {
+        fusedSteps = parseFusedSpec(fusedSpec);
+        if (fusedSteps[0] == "normalize") {
+            fusedGain = normalizationGain(audioData, sampleRate * fileInfo.channels, normalizeTarget);
+        }
+        branches.push_back({"Fused", outputFileFused, false, [&](std::vector<float>& data) {
+            applyFusedSteps(data, sampleRate, fusedSteps, firCoefficients, fusedGain);
+        }});
+    }
 
-    auto startNotch = high_resolution_clock::now();
-    applyNotchFilter(audioData, fileInfo.samplerate, 50.0f, 2);
-    auto endNotch = high_resolution_clock::now();
-    writeWavFile(outputFile2, audioData, fileInfo);
+    SOSCascade sosCascade;
+    if (!sosSpec.empty()) {
+        sosCascade = designFromSpec(sosSpec, sampleRate);
+        FilterBranch branch = {"SOS", outputFileSOS, false, nullptr};
+        branch.applyChannels = [&](PlanarAudio& planar) { applySOSFilterChannels(planar, sosCascade); };
+        branches.push_back(branch);
+    }
 
-    readWavFile(inputFile, audioData, fileInfo);
+    if (!filterKey.empty()) {
+        if (verify) {
+            std::cerr << "Error: --verify needs every filter; drop --filter" << std::endl;
+            return 1;
+        }
+        selectBranch(branches, filterKey);
+    }
 
-    std::vector<float> firCoefficients = {0.1, 0.15, 0.5, 0.15, 0.1};
-    auto startFIR = high_resolution_clock::now();
-    applyFIRFilter(audioData, firCoefficients);
-    auto endFIR = high_resolution_clock::now();
-    writeWavFile(outputFile3, audioData, fileInfo);
+    AllocationStats allocationsBefore = allocationStats();
+    auto startGraph = high_resolution_clock::now();
+    runFilterGraph(audioData, fileInfo, branches, normalizeTarget);
+    auto endGraph = high_resolution_clock::now();
+    AllocationStats graphAllocations = allocationStats();
+    graphAllocations.allocations -= allocationsBefore.allocations;
+    graphAllocations.bytes -= allocationsBefore.bytes;
+
+    if (verify) {
+        std::vector<float> normalized = audioData;
+        normalizeAudio(normalized, sampleRate * channels, parseNormalizeTarget("peak"));
+        std::vector<float> normalizeReference = audioData;
+        referenceNormalize(normalizeReference);
+        reportDifference("Normalize (peak)", normalized, normalizeReference, 1e-6f);
+        std::vector<float> passthrough = normalized;
+        applyPerChannel(passthrough, channels, [&](std::vector<float>& data) {
+            applySpectralFilter(data, sampleRate, [](float) { return 1.0f; });
+        });
+        reportDifference("STFT (all-pass)", passthrough, normalized, 1e-5f);
+
+        std::vector<float> firReference = audioData;
+        applyPerChannel(firReference, channels, [&](std::vector<float>& data) { referenceFIRFilter(data, firCoefficients); });
+        reportDifference("FIR", branches[2].output, firReference, firCoefficients.size() >= FFT_CONVOLUTION_MIN_TAPS ? 1e-4f : 1e-5f);
+
+        // The 5-tap filter stays on the direct kernel; check the FFT path
+        // with a long windowed-sinc low-pass as well.
+        std::vector<float> longCoefficients = windowedSincLowpass(511, 0.1f);
+        std::vector<float> longFiltered = audioData;
+        applyPerChannel(longFiltered, channels, [&](std::vector<float>& data) { applyFIRFilter(data, longCoefficients); });
+        std::vector<float> longReference = audioData;
+        applyPerChannel(longReference, channels, [&](std::vector<float>& data) { referenceFIRFilter(data, longCoefficients); });
+        reportDifference("FIR (FFT, 511 taps)", longFiltered, longReference, 1e-4f);
+
+        std::vector<float> iirReference = audioData;
+        applyPerChannel(iirReference, channels, [&](std::vector<float>& data) { referenceIIRFilter(data, b, a); });
+        reportDifference("IIR", branches[3].output, iirReference, 1e-4f);
+
+        if (!fusedSteps.empty()) {
+            std::vector<float> unfused = audioData;
+            if (fusedSteps[0] == "normalize") {
+                normalizeAudio(unfused, sampleRate * channels, normalizeTarget);
+            }
+            applyPerChannel(unfused, channels, [&](std::vector<float>& data) {
+                for (const std::string& step : fusedSteps) {
+                    if (step == "bandpass") {
+                        applyBandpassFilter(data, sampleRate, 300.0f, 3000.0f);
+                    } else if (step == "notch") {
+                        applyNotchFilter(data, sampleRate, 50.0f, 2);
+                    } else if (step == "fir") {
+                        referenceFIRFilter(data, firCoefficients);
+                    }
+                }
+            });
+            reportDifference("Fused chain", branches[4].output, unfused, 1e-4f);
+        }
 
-    readWavFile(inputFile, audioData, fileInfo);
+        // A single biquad is an ordinary direct-form IIR; a 4th-order
+        // Butterworth must be 3 dB down at its cutoff.
+        SOSCascade butterworth = designButterworth(BAND_LOWPASS, 4, sampleRate, 1000.0);
+        double cutoffGain = sosMagnitude(butterworth, sampleRate, 1000.0);
+        cout << "Verify SOS design: |H(1000 Hz)| = " << cutoffGain
+             << (std::fabs(cutoffGain - std::sqrt(0.5)) < 1e-3 ? " (ok)" : " (MISMATCH)") << endl;
+        const Biquad& section = butterworth[0];
+        std::vector<float> biquadFiltered = audioData;
+        applyPerChannel(biquadFiltered, channels, [&](std::vector<float>& data) { applySOSFilter(data, {section}); });
+        std::vector<float> biquadReference = audioData;
+        applyPerChannel(biquadReference, channels, [&](std::vector<float>& data) {
+            referenceIIRFilter(data, {section.b0, section.b1, section.b2}, {1.0f, section.a1, section.a2});
+        });
+        reportDifference("SOS biquad", biquadFiltered, biquadReference, 1e-4f);
+
+        if (!sosCascade.empty()) {
+            std::vector<float> scalarSOS = audioData;
+            applyPerChannel(scalarSOS, channels, [&](std::vector<float>& data) { applySOSFilter(data, sosCascade); });
+            reportDifference("SOS lanes (" + std::to_string(sosLaneWidth()) + " wide)", branches.back().output, scalarSOS, 0.0f);
+        }
 
-    std::vector<float> b = {0.1, 0.15, 0.5, 0.15, 0.1};
-    std::vector<float> a = {1.0, -0.5, 0.25};
-    auto startIIR = high_resolution_clock::now();
-    applyIIRFilter(audioData, b, a);
-    auto endIIR = high_resolution_clock::now();
-    writeWavFile(outputFile4, audioData, fileInfo);
+        std::string referenceFile = outputFile3 + ".reference";
+        SF_INFO referenceInfo = fileInfo;
+        writeWavFileSequential(referenceFile, branches[2].output, referenceInfo);
+        reportFilesIdentical("WAV writer", outputFile3, referenceFile);
+        remove(referenceFile.c_str());
+    }
 
     auto end = high_resolution_clock::now();
 
-    auto durationRead = duration_cast<milliseconds>(endRead - startRead).count();
-    auto durationWrite = duration_cast<milliseconds>(endWrite - startWrite).count();
-    auto durationBandpass = duration_cast<milliseconds>(endBandpass - startBandpass).count();
-    auto durationNotch = duration_cast<milliseconds>(endNotch - startNotch).count();
-    auto durationFIR = duration_cast<milliseconds>(endFIR - startFIR).count();
-    auto durationIIR = duration_cast<milliseconds>(endIIR - startIIR).count();
-    auto totalDuration = duration_cast<milliseconds>(end - start).count();
-
-
-    cout << "Time taken to read data: " << durationRead << " ms" << endl;
-    cout << "Time taken to write data: " << durationWrite << " ms" << endl;
-    cout << "Time taken to apply Band-pass Filter: " << durationBandpass << " ms" << endl;
-    cout << "Time taken to apply Notch Filter: " << durationNotch << " ms" << endl;
-    cout << "Time taken to apply FIR Filter: " << durationFIR << " ms" << endl;
-    cout << "Time taken to apply IIR Filter: " << durationIIR << " ms" << endl;
-    cout << "Total execution time: " << totalDuration << " ms" << endl;
+    auto durationRead = duration_cast<microseconds>(endRead - startRead).count();
+    auto durationGraph = duration_cast<microseconds>(endGraph - startGraph).count();
+    auto totalDuration = duration_cast<microseconds>(end - start).count();
+    long long durationWrite = 0;
+    for (const FilterBranch& branch : branches) {
+        durationWrite += branch.writeUs;
+    }
+
+    cout << "Worker threads: " << globalPool().size() << endl;
+    cout << "FIR kernel: " << firKernelName(selectFIRKernel(firCoefficients.size())) << endl;
+    if (timings) {
+        printTimings(branches, durationRead, durationWrite, durationGraph, totalDuration, graphAllocations);
+    }
+    cout << "Time taken to read data: " << durationRead / 1000 << " ms" << endl;
+    cout << "Time taken to write data: " << durationWrite / 1000 << " ms (all outputs)" << endl;
+    for (const FilterBranch& branch : branches) {
+        cout << "Time taken to apply " << branch.name << " Filter: " << branch.filterUs / 1000 << " ms" << endl;
+    }
+    cout << "Time taken to run all filter branches: " << durationGraph / 1000 << " ms" << endl;
+    cout << "Heap allocations while filtering: " << graphAllocations.allocations << " ("
+         << graphAllocations.bytes / (1 << 20) << " MB)" << endl;
+    cout << "Peak resident set: " << peakResidentKb() / 1024 << " MB" << endl;
+    cout << "Total execution time: " << totalDuration / 1000 << " ms" << endl;
 
     return 0;
 }
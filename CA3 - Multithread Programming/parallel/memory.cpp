@@ -0,0 +1,105 @@
+#include "memory.hpp"
+
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <sys/resource.h>
+
+using namespace std;
+
+static atomic<size_t> allocationCount(0);
+static atomic<size_t> allocatedBytes(0);
+
+ScratchArena& threadScratch() {
+    thread_local ScratchArena arena;
+    return arena;
+}
+
+AllocationStats allocationStats() {
+    AllocationStats stats;
+    stats.allocations = allocationCount.load(memory_order_relaxed);
+    stats.bytes = allocatedBytes.load(memory_order_relaxed);
+    return stats;
+}
+
+size_t peakResidentKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void* countedAllocate(size_t size, size_t alignment) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    allocatedBytes.fetch_add(size, memory_order_relaxed);
+    void* p = NULL;
+    if (alignment <= alignof(max_align_t)) {
+        p = malloc(size ? size : 1);
+    } else if (posix_memalign(&p, alignment, size ? size : 1) != 0) {
+        p = NULL;
+    }
+    return p;
+}
+
+void* operator new(size_t size) {
+    void* p = countedAllocate(size, 0);
+    if (p == NULL) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+    void* p = countedAllocate(size, static_cast<size_t>(alignment));
+    if (p == NULL) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size, align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    return countedAllocate(size, 0);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    return countedAllocate(size, 0);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, align_val_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, align_val_t) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t, align_val_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t, align_val_t) noexcept {
+    free(p);
+}
@@ -0,0 +1,35 @@
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <vector>
+#include <complex>
+#include <cstddef>
+
+// Scratch buffers owned by one thread (a pool worker or the main thread)
+// for as long as it lives. Kernels borrow them instead of constructing
+// vectors inside parallelFor bodies, so once each buffer has grown to the
+// largest segment plus halo seen, later calls and later files reuse the
+// same memory. A buffer is only borrowed for the duration of one chunk and
+// never across a nested parallelFor.
+struct ScratchArena {
+    std::vector<float> samples;
+    std::vector<float> output;
+    std::vector<float> lanes;
+    std::vector<double> state;
+    std::vector<std::complex<float>> spectrum;
+    std::vector<unsigned char> bytes;
+};
+
+ScratchArena& threadScratch();
+
+// Heap allocations made by the whole process so far (every operator new is
+// counted), and the peak resident set size.
+struct AllocationStats {
+    size_t allocations;
+    size_t bytes;
+};
+
+AllocationStats allocationStats();
+size_t peakResidentKb();
+
+#endif
@@ -0,0 +1,205 @@
+#include "pipeline.hpp"
+
+#include <iostream>
+#include <chrono>
+#include <pthread.h>
+#include <sndfile.h>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+struct InputBlock {
+    vector<float> samples;
+    bool last;
+};
+
+struct OutputBlock {
+    vector<vector<float>> chains;
+    bool last;
+};
+
+struct PipelineContext {
+    SNDFILE* inFile;
+    vector<SNDFILE*> outFiles;
+    int channels;
+    size_t blockFrames;
+
+    // filled: reader -> filter -> writer; empty buffers flow back the
+    // other way so every block in flight is reused.
+    SpscRing<InputBlock> filledInput;
+    SpscRing<InputBlock> emptyInput;
+    SpscRing<OutputBlock> filledOutput;
+    SpscRing<OutputBlock> emptyOutput;
+
+    PipelineStats readStats;
+    PipelineStats filterStats;
+    PipelineStats writeStats;
+
+    explicit PipelineContext(size_t depth)
+        : filledInput(depth), emptyInput(depth), filledOutput(depth), emptyOutput(depth) {}
+};
+
+double secondsSince(steady_clock::time_point start) {
+    return duration<double>(steady_clock::now() - start).count();
+}
+
+template <typename T>
+void pushWaiting(SpscRing<T>& ring, T& item, PipelineStats& stats) {
+    auto start = steady_clock::now();
+    if (!ring.push(item)) {
+        stats.stallSeconds += secondsSince(start);
+    }
+}
+
+template <typename T>
+void popWaiting(SpscRing<T>& ring, T& item, PipelineStats& stats) {
+    auto start = steady_clock::now();
+    if (!ring.pop(item)) {
+        stats.stallSeconds += secondsSince(start);
+    }
+}
+
+void* readerLoop(void* arg) {
+    PipelineContext* context = (PipelineContext*)arg;
+    PipelineStats& stats = context->readStats;
+    InputBlock block;
+
+    while (true) {
+        popWaiting(context->emptyInput, block, stats);
+
+        auto start = steady_clock::now();
+        block.samples.resize(context->blockFrames * context->channels);
+        sf_count_t frames = sf_readf_float(context->inFile, block.samples.data(), context->blockFrames);
+        block.samples.resize(max<sf_count_t>(frames, 0) * context->channels);
+        block.last = frames <= 0;
+        stats.busySeconds += secondsSince(start);
+
+        stats.samples += block.samples.size();
+        stats.blocks += block.last ? 0 : 1;
+        bool last = block.last;
+        pushWaiting(context->filledInput, block, stats);
+        if (last) {
+            return NULL;
+        }
+    }
+}
+
+void* writerLoop(void* arg) {
+    PipelineContext* context = (PipelineContext*)arg;
+    PipelineStats& stats = context->writeStats;
+    size_t numChains = context->outFiles.size();
+    int channels = context->channels;
+
+    // Look-ahead stages emit samples in hops that need not line up with
+    // frames, so a partial frame per output waits for the next block.
+    vector<vector<float>> carry(numChains);
+    OutputBlock block;
+
+    while (true) {
+        popWaiting(context->filledOutput, block, stats);
+
+        auto start = steady_clock::now();
+        for (size_t i = 0; i < numChains; ++i) {
+            vector<float>& pending = carry[i];
+            pending.insert(pending.end(), block.chains[i].begin(), block.chains[i].end());
+            sf_count_t frames = pending.size() / channels;
+            if (sf_writef_float(context->outFiles[i], pending.data(), frames) != frames) {
+                std::cerr << "Error writing frames to file." << std::endl;
+                exit(1);
+            }
+            pending.erase(pending.begin(), pending.begin() + frames * channels);
+            stats.samples += frames * channels;
+        }
+        stats.busySeconds += secondsSince(start);
+        stats.blocks += 1;
+
+        bool last = block.last;
+        pushWaiting(context->emptyOutput, block, stats);
+        if (last) {
+            return NULL;
+        }
+    }
+}
+
+}
+
+void runPipeline(const string& inputFile, vector<FilterChain>& chains, const vector<string>& outputFiles,
+                 size_t blockFrames, size_t depth, const ChainRunner& runner, vector<PipelineStats>& stats) {
+    PipelineContext context(depth);
+    context.readStats = {"read", 0, 0, 0.0, 0.0};
+    context.filterStats = {"filter", 0, 0, 0.0, 0.0};
+    context.writeStats = {"write", 0, 0, 0.0, 0.0};
+
+    SF_INFO fileInfo;
+    fileInfo.format = 0;
+    context.inFile = sf_open(inputFile.c_str(), SFM_READ, &fileInfo);
+    if (!context.inFile) {
+        std::cerr << "Error opening input file: " << sf_strerror(NULL) << std::endl;
+        exit(1);
+    }
+    context.channels = fileInfo.channels;
+    context.blockFrames = blockFrames;
+
+    context.outFiles.resize(chains.size());
+    for (size_t i = 0; i < chains.size(); ++i) {
+        SF_INFO outInfo = fileInfo;
+        context.outFiles[i] = sf_open(outputFiles[i].c_str(), SFM_WRITE, &outInfo);
+        if (!context.outFiles[i]) {
+            std::cerr << "Error opening output file: " << sf_strerror(NULL) << std::endl;
+            exit(1);
+        }
+    }
+
+    for (size_t i = 0; i < depth; ++i) {
+        InputBlock input = {vector<float>(blockFrames * fileInfo.channels), false};
+        context.emptyInput.push(input);
+        OutputBlock output = {vector<vector<float>>(chains.size()), false};
+        context.emptyOutput.push(output);
+    }
+
+    pthread_t reader;
+    pthread_t writer;
+    pthread_create(&reader, NULL, readerLoop, &context);
+    pthread_create(&writer, NULL, writerLoop, &context);
+
+    PipelineStats& filterStats = context.filterStats;
+    InputBlock input;
+    OutputBlock output;
+    while (true) {
+        popWaiting(context.filledInput, input, filterStats);
+        popWaiting(context.emptyOutput, output, filterStats);
+
+        auto start = steady_clock::now();
+        runner(chains.size(), [&](size_t i) {
+            output.chains[i].clear();
+            if (input.last) {
+                chains[i].flush(output.chains[i]);
+            } else {
+                chains[i].process(input.samples, output.chains[i]);
+            }
+        });
+        output.last = input.last;
+        filterStats.busySeconds += secondsSince(start);
+        filterStats.samples += input.samples.size();
+        filterStats.blocks += input.last ? 0 : 1;
+
+        bool last = input.last;
+        pushWaiting(context.emptyInput, input, filterStats);
+        pushWaiting(context.filledOutput, output, filterStats);
+        if (last) {
+            break;
+        }
+    }
+
+    pthread_join(reader, NULL);
+    pthread_join(writer, NULL);
+
+    sf_close(context.inFile);
+    for (SNDFILE* outFile : context.outFiles) {
+        sf_close(outFile);
+    }
+
+    stats = {context.readStats, context.filterStats, context.writeStats};
+}
@@ -0,0 +1,126 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "../common/stream.hpp"
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. Items are moved in and out; the slots keep their storage, so
+// recycled buffers do not reallocate. push/pop block: they retry briefly,
+// then sleep until the other side moves an item, so a stalled stage does
+// not hold a core that the filter workers could use.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) : head(0), tail(0) {
+        size_t size = 1;
+        while (size < capacity + 1) {
+            size <<= 1;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    // Both return false if the call had to wait.
+    bool push(T& item) {
+        bool immediate = waitFor([&] { return tryPush(item); });
+        wakeWaiter();
+        return immediate;
+    }
+
+    bool pop(T& item) {
+        bool immediate = waitFor([&] { return tryPop(item); });
+        wakeWaiter();
+        return immediate;
+    }
+
+private:
+    bool tryPush(T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (((t + 1) & mask) == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        std::swap(slots[t], item);
+        tail.store((t + 1) & mask, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        std::swap(item, slots[h]);
+        head.store((h + 1) & mask, std::memory_order_release);
+        return true;
+    }
+
+    static const int SPIN_TRIES = 64;
+
+    template <typename Attempt>
+    bool waitFor(const Attempt& attempt) {
+        if (attempt()) {
+            return true;
+        }
+        for (int i = 0; i < SPIN_TRIES; ++i) {
+            std::this_thread::yield();
+            if (attempt()) {
+                return false;
+            }
+        }
+        // Announce the sleeper before the last check, so the other side
+        // either sees it in wakeWaiter or has already moved the index that
+        // this check reads.
+        std::unique_lock<std::mutex> lock(waitMutex);
+        waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!attempt()) {
+            waitCondition.wait(lock);
+        }
+        waiting.store(false, std::memory_order_relaxed);
+        return false;
+    }
+
+    // The ring can never be full and empty at once, so at most one side is
+    // asleep at a time.
+    void wakeWaiter() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(waitMutex);
+            waitCondition.notify_one();
+        }
+    }
+
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+    std::atomic<bool> waiting{false};
+    std::mutex waitMutex;
+    std::condition_variable waitCondition;
+};
+
+struct PipelineStats {
+    std::string stage;
+    size_t blocks;
+    size_t samples;
+    double busySeconds;
+    double stallSeconds;
+};
+
+const size_t PIPELINE_DEPTH = 4;
+
+// Three-stage form of streamFilterChains: a reader thread decodes blocks,
+// the calling thread runs the chains (through `runner`) and a writer thread
+// encodes the results, with `depth` blocks in flight between neighbours.
+// Stats come back per stage; stall time is time spent waiting on a full or
+// empty ring.
+void runPipeline(const std::string& inputFile, std::vector<FilterChain>& chains, const std::vector<std::string>& outputFiles,
+                 size_t blockFrames, size_t depth, const ChainRunner& runner, std::vector<PipelineStats>& stats);
+
+#endif
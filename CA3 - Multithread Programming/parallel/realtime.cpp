@@ -0,0 +1,247 @@
+#include "realtime.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+PcmFormat parsePcmFormat(const string& name) {
+    if (name == "s16") {
+        return PCM_S16;
+    }
+    if (name == "f32") {
+        return PCM_F32;
+    }
+    cerr << "Error: unknown PCM format '" << name << "' (expected s16 or f32)" << endl;
+    exit(1);
+}
+
+RealtimeFIRStage::RealtimeFIRStage(const vector<float>& coefficients, size_t maxFrames)
+    : coefficients(coefficients), kernel(selectFIRKernel(coefficients.size())) {
+    line.assign(coefficients.size() - 1 + maxFrames, 0.0f);
+}
+
+void RealtimeFIRStage::process(float* block, size_t frames) {
+    size_t halo = coefficients.size() - 1;
+    copy(block, block + frames, line.begin() + halo);
+    kernel(line.data() + halo, block, frames, coefficients.data(), coefficients.size());
+    copy(line.begin() + frames, line.begin() + frames + halo, line.begin());
+}
+
+RealtimeIIRStage::RealtimeIIRStage(const vector<float>& b, const vector<float>& a) : b(b), a(a) {
+    size_t order = max(b.size(), a.size());
+    this->b.resize(order, 0.0f);
+    this->a.resize(order, 0.0f);
+    state.assign(order, 0.0f);
+}
+
+void RealtimeIIRStage::process(float* block, size_t frames) {
+    size_t order = b.size();
+    for (size_t n = 0; n < frames; ++n) {
+        float x = block[n];
+        float y = b[0] * x + state[0];
+        for (size_t i = 1; i < order; ++i) {
+            state[i - 1] = b[i] * x - a[i] * y + state[i];
+        }
+        block[n] = y;
+    }
+}
+
+RealtimeSOSStage::RealtimeSOSStage(const SOSCascade& cascade) : cascade(cascade) {
+    // processSOS sizes the state on first use; doing it here keeps that
+    // allocation off the audio path.
+    state.assign(2 * cascade.size(), 0.0f);
+}
+
+void RealtimeSOSStage::process(float* block, size_t frames) {
+    processSOS(cascade, block, frames, state);
+}
+
+vector<string> parseRealtimeSpec(const string& spec) {
+    vector<string> steps;
+    stringstream ss(spec);
+    string step;
+    while (getline(ss, step, ',')) {
+        if (step != "fir" && step != "iir" && step != "notch" && step != "sos") {
+            cerr << "Error: unknown real-time step '" << step << "' (expected fir, iir, notch or sos)" << endl;
+            exit(1);
+        }
+        steps.push_back(step);
+    }
+    if (steps.empty()) {
+        cerr << "Error: --realtime needs at least one step" << endl;
+        exit(1);
+    }
+    return steps;
+}
+
+namespace {
+
+// Fills `buffer` unless the input ends first; returns the bytes read.
+size_t readFully(int fd, char* buffer, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t got = read(fd, buffer + done, size - done);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            perror("read");
+            exit(1);
+        }
+        if (got == 0) {
+            break;
+        }
+        done += got;
+    }
+    return done;
+}
+
+bool writeFully(int fd, const char* buffer, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, buffer, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        buffer += written;
+        size -= written;
+    }
+    return true;
+}
+
+// The spectral notch in the file modes has the gain 1/(1 + (f0/f)^(2*order)),
+// the squared magnitude of an order-`order` Butterworth high-pass. Running
+// that high-pass twice gives the same gain with a causal, zero-latency
+// filter instead of a 2048-sample frame.
+SOSCascade realtimeNotch(int sampleRate, double frequency, int order) {
+    SOSCascade half = designButterworth(BAND_HIGHPASS, order, sampleRate, frequency);
+    SOSCascade cascade = half;
+    cascade.insert(cascade.end(), half.begin(), half.end());
+    return cascade;
+}
+
+void decodeBlock(const char* raw, PcmFormat format, size_t frames, int channels, vector<vector<float>>& planar) {
+    for (size_t n = 0; n < frames; ++n) {
+        for (int c = 0; c < channels; ++c) {
+            size_t i = n * channels + c;
+            if (format == PCM_S16) {
+                int16_t value;
+                memcpy(&value, raw + 2 * i, 2);
+                planar[c][n] = value * (1.0f / 0x8000);
+            } else {
+                memcpy(&planar[c][n], raw + 4 * i, 4);
+            }
+        }
+    }
+}
+
+// Live output clips rather than wrapping around.
+void encodeBlock(const vector<vector<float>>& planar, PcmFormat format, size_t frames, int channels, char* raw) {
+    for (size_t n = 0; n < frames; ++n) {
+        for (int c = 0; c < channels; ++c) {
+            size_t i = n * channels + c;
+            if (format == PCM_S16) {
+                float scaled = min(max(planar[c][n] * (float)0x7FFF, -32768.0f), 32767.0f);
+                int16_t value = (int16_t)lrintf(scaled);
+                memcpy(raw + 2 * i, &value, 2);
+            } else {
+                memcpy(raw + 4 * i, &planar[c][n], 4);
+            }
+        }
+    }
+}
+
+}
+
+LatencyHistogram runRealtime(const RealtimeOptions& options, int inputFd, int outputFd) {
+    size_t blockFrames = options.blockFrames;
+    int channels = options.channels;
+    size_t frameBytes = channels * (options.format == PCM_S16 ? 2 : 4);
+
+    vector<vector<unique_ptr<RealtimeStage>>> chains(channels);
+    for (int c = 0; c < channels; ++c) {
+        for (const string& step : options.steps) {
+            if (step == "fir") {
+                chains[c].emplace_back(new RealtimeFIRStage(options.firCoefficients, blockFrames));
+            } else if (step == "iir") {
+                chains[c].emplace_back(new RealtimeIIRStage(options.b, options.a));
+            } else if (step == "notch") {
+                chains[c].emplace_back(new RealtimeSOSStage(realtimeNotch(options.sampleRate, 50.0, 2)));
+            } else {
+                chains[c].emplace_back(new RealtimeSOSStage(options.sos));
+            }
+        }
+    }
+
+    vector<char> raw(blockFrames * frameBytes);
+    vector<vector<float>> planar(channels, vector<float>(blockFrames));
+
+    LatencyHistogram histogram;
+    memset(&histogram, 0, sizeof(histogram));
+    histogram.deadlineUs = 1e6 * blockFrames / options.sampleRate;
+
+    while (true) {
+        size_t bytes = readFully(inputFd, raw.data(), raw.size());
+        size_t frames = bytes / frameBytes;
+        if (frames == 0) {
+            break;
+        }
+
+        auto start = steady_clock::now();
+        decodeBlock(raw.data(), options.format, frames, channels, planar);
+        for (int c = 0; c < channels; ++c) {
+            for (unique_ptr<RealtimeStage>& stage : chains[c]) {
+                stage->process(planar[c].data(), frames);
+            }
+        }
+        encodeBlock(planar, options.format, frames, channels, raw.data());
+        double us = duration<double, micro>(steady_clock::now() - start).count();
+
+        int bucket = 0;
+        while (bucket + 1 < LatencyHistogram::BUCKETS && us >= (double)(1u << bucket)) {
+            ++bucket;
+        }
+        histogram.counts[bucket]++;
+        histogram.blocks++;
+        histogram.totalUs += us;
+        histogram.maxUs = max(histogram.maxUs, us);
+        if (us > histogram.deadlineUs) {
+            histogram.overruns++;
+        }
+
+        if (!writeFully(outputFd, raw.data(), frames * frameBytes)) {
+            break;
+        }
+        if (bytes < raw.size()) {
+            break;
+        }
+    }
+    return histogram;
+}
+
+void printLatencyReport(ostream& out, const LatencyHistogram& histogram) {
+    out << "Realtime: " << histogram.blocks << " blocks, deadline " << histogram.deadlineUs << " us, mean "
+        << (histogram.blocks ? histogram.totalUs / histogram.blocks : 0.0) << " us, max " << histogram.maxUs
+        << " us, " << histogram.overruns << " over deadline" << endl;
+
+    size_t seen = 0;
+    for (int k = 0; k < LatencyHistogram::BUCKETS; ++k) {
+        if (histogram.counts[k] == 0) {
+            continue;
+        }
+        seen += histogram.counts[k];
+        double low = k == 0 ? 0.0 : (double)(1u << (k - 1));
+        out << "  [" << low << ", " << (double)(1u << k) << ") us: " << histogram.counts[k]
+            << " (" << 100.0 * seen / histogram.blocks << "% cumulative)" << endl;
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef REALTIME_HPP
+#define REALTIME_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <ostream>
+#include "fir_kernels.hpp"
+#include "../common/sos.hpp"
+
+// Raw interleaved little-endian PCM, as piped by arecord/sox -t raw.
+enum PcmFormat {
+    PCM_S16,
+    PCM_F32
+};
+
+PcmFormat parsePcmFormat(const std::string& name);
+
+const size_t REALTIME_MIN_BLOCK_FRAMES = 64;
+const size_t REALTIME_MAX_BLOCK_FRAMES = 1024;
+const size_t REALTIME_DEFAULT_BLOCK_FRAMES = 256;
+
+// In-place filter for one channel of a live stream. All buffers are sized
+// for maxFrames in the constructor; process() never allocates.
+class RealtimeStage {
+public:
+    virtual ~RealtimeStage() {}
+    virtual void process(float* block, size_t frames) = 0;
+};
+
+// FIR on the SIMD kernels: the last taps-1 inputs sit in front of the
+// block, so the kernel reads its history without boundary checks.
+class RealtimeFIRStage : public RealtimeStage {
+public:
+    RealtimeFIRStage(const std::vector<float>& coefficients, size_t maxFrames);
+    void process(float* block, size_t frames) override;
+
+private:
+    std::vector<float> coefficients;
+    std::vector<float> line;
+    FIRKernel kernel;
+};
+
+// Direct-form IIR (a[0] taken as 1) in transposed form: one state per
+// delay instead of separate input and output histories.
+class RealtimeIIRStage : public RealtimeStage {
+public:
+    RealtimeIIRStage(const std::vector<float>& b, const std::vector<float>& a);
+    void process(float* block, size_t frames) override;
+
+private:
+    std::vector<float> b;
+    std::vector<float> a;
+    std::vector<float> state;
+};
+
+class RealtimeSOSStage : public RealtimeStage {
+public:
+    explicit RealtimeSOSStage(const SOSCascade& cascade);
+    void process(float* block, size_t frames) override;
+
+private:
+    SOSCascade cascade;
+    SOSState state;
+};
+
+// Per-block processing time (decode, filter, encode; not the pipe I/O) in
+// power-of-two buckets: bucket 0 holds blocks under 1 us, bucket k those in
+// [2^(k-1), 2^k) us.
+struct LatencyHistogram {
+    static const int BUCKETS = 24;
+    size_t counts[BUCKETS];
+    size_t blocks;
+    size_t overruns;
+    double totalUs;
+    double maxUs;
+    double deadlineUs;
+};
+
+// blockFrames 0 means REALTIME_DEFAULT_BLOCK_FRAMES.
+struct RealtimeOptions {
+    int sampleRate = 0;
+    int channels = 1;
+    size_t blockFrames = 0;
+    PcmFormat format = PCM_S16;
+    std::vector<std::string> steps;
+    std::vector<float> firCoefficients;
+    std::vector<float> b;
+    std::vector<float> a;
+    SOSCascade sos;
+};
+
+// Splits a --realtime spec such as "fir,iir,notch" into its steps (fir,
+// iir, notch or sos).
+std::vector<std::string> parseRealtimeSpec(const std::string& spec);
+
+// Reads blocks of options.blockFrames frames from inputFd until end of
+// input, filters each channel through the steps in order and writes the
+// block to outputFd before reading the next one. A short final block is
+// processed as is. Runs on the calling thread only.
+LatencyHistogram runRealtime(const RealtimeOptions& options, int inputFd, int outputFd);
+
+void printLatencyReport(std::ostream& out, const LatencyHistogram& histogram);
+
+#endif
@@ -0,0 +1,150 @@
+#include "sos_lanes.hpp"
+#include "thread_pool.hpp"
+#include "memory.hpp"
+#include "fir_kernels.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Frames per block: the lane-interleaved block (8 lanes * 4 bytes * 512)
+// stays in L1 while every section runs over it.
+const size_t SOS_LANE_BLOCK = 512;
+
+// Runs `frames` lane-interleaved frames through the cascade in place.
+// `state` holds s1 and s2 of every section, one vector each.
+typedef void (*SOSLaneKernel)(const SOSCascade& cascade, float* block, size_t frames, float* state);
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Multiplies and adds in the same order as processSOS, without FMA, so
+// every lane matches the scalar cascade exactly.
+static void sosLaneKernelSSE(const SOSCascade& cascade, float* block, size_t frames, float* state) {
+    for (size_t i = 0; i < cascade.size(); ++i) {
+        const Biquad& s = cascade[i];
+        __m128 b0 = _mm_set1_ps(s.b0), b1 = _mm_set1_ps(s.b1), b2 = _mm_set1_ps(s.b2);
+        __m128 a1 = _mm_set1_ps(s.a1), a2 = _mm_set1_ps(s.a2);
+        __m128 s1 = _mm_loadu_ps(state + 8 * i);
+        __m128 s2 = _mm_loadu_ps(state + 8 * i + 4);
+        for (size_t n = 0; n < frames; ++n) {
+            __m128 x = _mm_loadu_ps(block + 4 * n);
+            __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), s1);
+            s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), s2);
+            s2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+            _mm_storeu_ps(block + 4 * n, y);
+        }
+        _mm_storeu_ps(state + 8 * i, s1);
+        _mm_storeu_ps(state + 8 * i + 4, s2);
+    }
+}
+
+__attribute__((target("avx2")))
+static void sosLaneKernelAVX2(const SOSCascade& cascade, float* block, size_t frames, float* state) {
+    for (size_t i = 0; i < cascade.size(); ++i) {
+        const Biquad& s = cascade[i];
+        __m256 b0 = _mm256_set1_ps(s.b0), b1 = _mm256_set1_ps(s.b1), b2 = _mm256_set1_ps(s.b2);
+        __m256 a1 = _mm256_set1_ps(s.a1), a2 = _mm256_set1_ps(s.a2);
+        __m256 s1 = _mm256_loadu_ps(state + 16 * i);
+        __m256 s2 = _mm256_loadu_ps(state + 16 * i + 8);
+        for (size_t n = 0; n < frames; ++n) {
+            __m256 x = _mm256_loadu_ps(block + 8 * n);
+            __m256 y = _mm256_add_ps(_mm256_mul_ps(b0, x), s1);
+            s1 = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(b1, x), _mm256_mul_ps(a1, y)), s2);
+            s2 = _mm256_sub_ps(_mm256_mul_ps(b2, x), _mm256_mul_ps(a2, y));
+            _mm256_storeu_ps(block + 8 * n, y);
+        }
+        _mm256_storeu_ps(state + 16 * i, s1);
+        _mm256_storeu_ps(state + 16 * i + 8, s2);
+    }
+}
+
+#endif
+
+static SOSLaneKernel selectSOSLaneKernel(size_t& width) {
+#if defined(__x86_64__) || defined(__i386__)
+    FIRKernel fir = selectFIRKernel();
+    if (fir == firKernelAVX2) {
+        width = 8;
+        return sosLaneKernelAVX2;
+    }
+    if (fir == firKernelSSE) {
+        width = 4;
+        return sosLaneKernelSSE;
+    }
+#endif
+    width = 1;
+    return NULL;
+}
+
+size_t sosLaneWidth() {
+    size_t width;
+    selectSOSLaneKernel(width);
+    return width;
+}
+
+// Filters up to `width` signals together. Lanes past the end of a shorter
+// signal (or without a signal) see zeros; the recursion is causal, so that
+// padding never reaches the samples that are kept.
+static void filterLaneGroup(SOSLaneKernel kernel, size_t width, const SOSCascade& cascade, vector<float>* const* group, size_t count) {
+    size_t frames = 0;
+    for (size_t l = 0; l < count; ++l) {
+        frames = max(frames, group[l]->size());
+    }
+
+    // The block and the lane states share one scratch buffer.
+    vector<float>& scratch = threadScratch().lanes;
+    scratch.assign(SOS_LANE_BLOCK * width + 2 * width * cascade.size(), 0.0f);
+    float* block = scratch.data();
+    float* state = block + SOS_LANE_BLOCK * width;
+    for (size_t start = 0; start < frames; start += SOS_LANE_BLOCK) {
+        size_t length = min(SOS_LANE_BLOCK, frames - start);
+        fill(block, block + SOS_LANE_BLOCK * width, 0.0f);
+        for (size_t l = 0; l < count; ++l) {
+            const vector<float>& signal = *group[l];
+            size_t end = min(signal.size(), start + length);
+            for (size_t n = start; n < end; ++n) {
+                block[(n - start) * width + l] = signal[n];
+            }
+        }
+
+        kernel(cascade, block, length, state);
+
+        for (size_t l = 0; l < count; ++l) {
+            vector<float>& signal = *group[l];
+            size_t end = min(signal.size(), start + length);
+            for (size_t n = start; n < end; ++n) {
+                signal[n] = block[(n - start) * width + l];
+            }
+        }
+    }
+}
+
+void applySOSFilterLanes(const vector<vector<float>*>& signals, const SOSCascade& cascade) {
+    StageScope stage("iir");
+    static size_t width;
+    static const SOSLaneKernel kernel = selectSOSLaneKernel(width);
+
+    // Longest first, so each group pads as little as possible.
+    vector<vector<float>*> order(signals);
+    stable_sort(order.begin(), order.end(), [](const vector<float>* x, const vector<float>* y) {
+        return x->size() > y->size();
+    });
+
+    size_t groupWidth = kernel ? width : 1;
+    size_t groups = (order.size() + groupWidth - 1) / groupWidth;
+    globalPool().parallelFor(0, groups, [&](size_t first, size_t last) {
+        for (size_t g = first; g < last; ++g) {
+            size_t begin = g * groupWidth;
+            size_t count = min(order.size() - begin, groupWidth);
+            if (count == 1) {
+                applySOSFilter(*order[begin], cascade);
+            } else {
+                filterLaneGroup(kernel, width, cascade, &order[begin], count);
+            }
+        }
+    }, 1);
+}
@@ -0,0 +1,18 @@
+#ifndef SOS_LANES_HPP
+#define SOS_LANES_HPP
+
+#include <vector>
+#include "../common/sos.hpp"
+
+// Filters several independent signals (the channels of one file, or whole
+// files) with the same cascade. A biquad recursion cannot be vectorised
+// along time, so each signal gets one SIMD lane instead: 8 signals per
+// vector with AVX2, 4 with SSE, following the FIR kernel choice
+// (FILTER_SIMD applies). Lane groups run side by side on the pool. Signals
+// may differ in length, and the results are bit-identical to processSOS.
+void applySOSFilterLanes(const std::vector<std::vector<float>*>& signals, const SOSCascade& cascade);
+
+// Signals per vector of the selected kernel (1 for the scalar fallback).
+size_t sosLaneWidth();
+
+#endif
@@ -0,0 +1,84 @@
+#include "stft.hpp"
+#include "thread_pool.hpp"
+#include "memory.hpp"
+#include "../common/fft.hpp"
+
+#include <cmath>
+#include <complex>
+#include <algorithm>
+
+using namespace std;
+
+void applySpectralFilter(vector<float>& data, int sampleRate, const function<float(float)>& response, size_t frameSize) {
+    applySpectralFilter(data, designSpectralGains(sampleRate, frameSize, response));
+}
+
+void applySpectralFilter(vector<float>& data, const SampleTable& gainTable) {
+    if (data.empty()) {
+        return;
+    }
+
+    size_t frameSize = gainTable->size();
+    FFTPlan plan(frameSize);
+    size_t hop = frameSize / 2;
+    SampleTable windowTable = hannWindow(frameSize);
+    const vector<float>& window = *windowTable;
+    const vector<float>& gains = *gainTable;
+
+    // Frame j starts at (j - 1) * hop, so every sample is covered by exactly
+    // two frames, including the first and last hop of the signal.
+    long size = data.size();
+    size_t numFrames = (data.size() + hop - 1) / hop + 1;
+    vector<float> filteredData(data.size(), 0.0f);
+    releaseForFirstTouch(filteredData);
+
+    auto frameStart = [hop](size_t frame) { return (long)(frame * hop) - (long)hop; };
+
+    // Frames of the same parity do not overlap, so each parity is one
+    // race-free parallel pass. The spectrum of two real frames is computed
+    // with one complex transform (one in the real part, one in the imaginary
+    // part); the response is real and symmetric, so they stay separate.
+    for (size_t parity = 0; parity < 2; ++parity) {
+        size_t framesOfParity = (numFrames - parity + 1) / 2;
+        size_t numPairs = (framesOfParity + 1) / 2;
+
+        globalPool().parallelFor(0, numPairs, [&](size_t firstPair, size_t lastPair) {
+            vector<complex<float>>& scratch = threadScratch().spectrum;
+            for (size_t pair = firstPair; pair < lastPair; ++pair) {
+                size_t frameA = parity + 4 * pair;
+                size_t frameB = frameA + 2;
+                bool hasB = frameB < numFrames;
+                long startA = frameStart(frameA);
+                long startB = frameStart(frameB);
+
+                scratch.assign(frameSize, complex<float>(0.0f, 0.0f));
+                for (size_t i = 0; i < frameSize; ++i) {
+                    long a = startA + (long)i;
+                    long b = startB + (long)i;
+                    float re = (a >= 0 && a < size) ? data[a] * window[i] : 0.0f;
+                    float im = (hasB && b >= 0 && b < size) ? data[b] * window[i] : 0.0f;
+                    scratch[i] = complex<float>(re, im);
+                }
+
+                plan.transform(scratch, false);
+                for (size_t k = 0; k < frameSize; ++k) {
+                    scratch[k] *= gains[k];
+                }
+                plan.transform(scratch, true);
+
+                for (size_t i = 0; i < frameSize; ++i) {
+                    long a = startA + (long)i;
+                    long b = startB + (long)i;
+                    if (a >= 0 && a < size) {
+                        filteredData[a] += scratch[i].real();
+                    }
+                    if (hasB && b >= 0 && b < size) {
+                        filteredData[b] += scratch[i].imag();
+                    }
+                }
+            }
+        });
+    }
+
+    data.swap(filteredData);
+}
@@ -0,0 +1,21 @@
+#ifndef STFT_HPP
+#define STFT_HPP
+
+#include <vector>
+#include <functional>
+#include "../common/design.hpp"
+
+const size_t STFT_FRAME_SIZE = 2048;
+
+// Filters `data` in the frequency domain: Hann-windowed frames with 50%
+// overlap are transformed, each bin is scaled by response(f) for its
+// frequency f in Hz, and the frames are transformed back and overlap-added.
+// With the periodic Hann window at this hop the windows sum to one, so a
+// response of 1 everywhere gives back the input.
+void applySpectralFilter(std::vector<float>& data, int sampleRate, const std::function<float(float)>& response, size_t frameSize = STFT_FRAME_SIZE);
+
+// Same, with the per-bin gains precomputed by the design layer (see
+// designSpectralGains); the frame size is gains->size().
+void applySpectralFilter(std::vector<float>& data, const SampleTable& gains);
+
+#endif
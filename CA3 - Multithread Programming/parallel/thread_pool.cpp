@@ -0,0 +1,304 @@
+#include "thread_pool.hpp"
+
+#include <iostream>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <cstdint>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+namespace {
+
+struct ParallelForJob {
+    const function<void(size_t, size_t)>* body;
+    size_t begin;
+    size_t end;
+    size_t grain;
+    size_t numChunks;
+    size_t stageLimit;
+    atomic<size_t> nextChunk;
+    size_t doneChunks;
+    mutex doneMutex;
+    condition_variable doneCondition;
+};
+
+thread_local size_t currentStageLimit = 0;
+
+void runChunks(ParallelForJob& job) {
+    // Chunks run under the caller's stage cap, so a parallelFor nested in
+    // a chunk is capped the same on a worker as on the calling thread.
+    size_t callerLimit = currentStageLimit;
+    currentStageLimit = job.stageLimit;
+    size_t finished = 0;
+    for (size_t chunk = job.nextChunk++; chunk < job.numChunks; chunk = job.nextChunk++) {
+        size_t start = job.begin + chunk * job.grain;
+        size_t stop = min(job.end, start + job.grain);
+        (*job.body)(start, stop);
+        ++finished;
+    }
+    currentStageLimit = callerLimit;
+
+    if (finished > 0) {
+        lock_guard<mutex> lock(job.doneMutex);
+        job.doneChunks += finished;
+        if (job.doneChunks == job.numChunks) {
+            job.doneCondition.notify_all();
+        }
+    }
+}
+
+size_t requestedThreads = 0;
+unique_ptr<ThreadPool> pool;
+mutex poolMutex;
+
+bool pinningRequested = false;
+map<string, size_t> stageLimits;
+bool stageLimitsLoaded = false;
+
+const size_t FIRST_TOUCH_MIN_BYTES = 1 << 20;
+
+bool pinningEnabled() {
+    const char* env = getenv("FILTER_PIN");
+    return pinningRequested || (env != NULL && strcmp(env, "1") == 0);
+}
+
+void pinThread(pthread_t thread, const vector<int>& cpus, size_t index) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[index % cpus.size()], &set);
+    if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0) {
+        std::cerr << "Warning: could not pin thread to CPU " << cpus[index % cpus.size()] << std::endl;
+    }
+}
+
+void parseStageLimits(const string& spec) {
+    size_t begin = 0;
+    while (begin < spec.size()) {
+        size_t comma = spec.find(',', begin);
+        if (comma == string::npos) {
+            comma = spec.size();
+        }
+        string item = spec.substr(begin, comma - begin);
+        size_t equals = item.find('=');
+        if (equals == string::npos || atoi(item.c_str() + equals + 1) <= 0) {
+            std::cerr << "Error: bad stage thread setting '" << item << "' (expected stage=N)" << std::endl;
+            exit(1);
+        }
+        stageLimits[item.substr(0, equals)] = atoi(item.c_str() + equals + 1);
+        begin = comma + 1;
+    }
+}
+
+}
+
+ThreadPool::ThreadPool(size_t numThreads) : stopping(false) {
+    if (numThreads == 0) {
+        numThreads = 1;
+    }
+
+    workers.resize(numThreads);
+    for (size_t i = 0; i < numThreads; ++i) {
+        if (pthread_create(&workers[i], NULL, workerLoop, this) != 0) {
+            std::cerr << "Error creating worker thread." << std::endl;
+            exit(1);
+        }
+    }
+
+    if (pinningEnabled()) {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+        vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            pinThread(pthread_self(), cpus, 0);
+            for (size_t i = 0; i < numThreads; ++i) {
+                pinThread(workers[i], cpus, i + 1);
+            }
+        }
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_all();
+
+    for (pthread_t& worker : workers) {
+        pthread_join(worker, NULL);
+    }
+}
+
+void ThreadPool::submit(function<void()> task) {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        tasks.push(std::move(task));
+    }
+    queueCondition.notify_one();
+}
+
+void* ThreadPool::workerLoop(void* arg) {
+    ThreadPool* self = (ThreadPool*)arg;
+
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(self->queueMutex);
+            self->queueCondition.wait(lock, [self] { return self->stopping || !self->tasks.empty(); });
+            if (self->tasks.empty()) {
+                return NULL;
+            }
+            task = std::move(self->tasks.front());
+            self->tasks.pop();
+        }
+        task();
+    }
+}
+
+size_t ThreadPool::concurrency() const {
+    return currentStageLimit > 0 ? min(size(), currentStageLimit) : size();
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, const function<void(size_t, size_t)>& body, size_t grain) {
+    if (begin >= end) {
+        return;
+    }
+
+    size_t count = end - begin;
+    size_t participants = concurrency();
+    if (grain == 0) {
+        grain = (count + participants - 1) / participants;
+    }
+
+    // Helpers can be dequeued after every chunk is already done, so they
+    // share ownership of the job rather than pointing into this frame.
+    shared_ptr<ParallelForJob> job = make_shared<ParallelForJob>();
+    job->body = &body;
+    job->begin = begin;
+    job->end = end;
+    job->grain = grain;
+    job->numChunks = (count + grain - 1) / grain;
+    job->stageLimit = currentStageLimit;
+    job->nextChunk = 0;
+    job->doneChunks = 0;
+
+    // One helper per worker at most; each helper keeps taking chunks until
+    // none are left, so the queue sees a handful of pushes per call.
+    size_t helpers = min(currentStageLimit > 0 ? currentStageLimit - 1 : size(), job->numChunks - 1);
+    helpers = min(helpers, size());
+    for (size_t i = 0; i < helpers; ++i) {
+        submit([job] { runChunks(*job); });
+    }
+
+    runChunks(*job);
+
+    unique_lock<mutex> lock(job->doneMutex);
+    job->doneCondition.wait(lock, [&job] { return job->doneChunks == job->numChunks; });
+}
+
+size_t defaultThreadCount() {
+    if (requestedThreads > 0) {
+        return requestedThreads;
+    }
+
+    const char* env = getenv("FILTER_THREADS");
+    if (env != NULL) {
+        int value = atoi(env);
+        if (value > 0) {
+            return value;
+        }
+    }
+
+    size_t hardware = thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+void setThreadCount(size_t numThreads) {
+    lock_guard<mutex> lock(poolMutex);
+    requestedThreads = numThreads;
+    pool.reset();
+}
+
+ThreadPool& globalPool() {
+    lock_guard<mutex> lock(poolMutex);
+    if (!pool) {
+        pool.reset(new ThreadPool(defaultThreadCount()));
+    }
+    return *pool;
+}
+
+void setThreadPinning(bool enabled) {
+    lock_guard<mutex> lock(poolMutex);
+    pinningRequested = enabled;
+    pool.reset();
+}
+
+void setStageThreads(const string& spec) {
+    lock_guard<mutex> lock(poolMutex);
+    parseStageLimits(spec);
+    stageLimitsLoaded = true;
+}
+
+StageScope::StageScope(const char* stage) : previousLimit(currentStageLimit) {
+    lock_guard<mutex> lock(poolMutex);
+    if (!stageLimitsLoaded) {
+        const char* env = getenv("FILTER_STAGE_THREADS");
+        if (env != NULL) {
+            parseStageLimits(env);
+        }
+        stageLimitsLoaded = true;
+    }
+    auto found = stageLimits.find(stage);
+    if (found != stageLimits.end()) {
+        currentStageLimit = found->second;
+    }
+}
+
+StageScope::~StageScope() {
+    currentStageLimit = previousLimit;
+}
+
+// This leans on the allocator and the kernel rather than on each segment
+// allocating its own memory:
+// - The vector's storage must be private anonymous memory. glibc's malloc
+//   (which the counting operator new in memory.cpp forwards to) serves
+//   large blocks from their own mmap or from the brk heap, and both are.
+//   For such memory, MADV_DONTNEED makes the next access fault in a fresh
+//   zero page. The contents therefore read back as zeros, which is what a
+//   value-initialised vector already holds.
+// - Only whole pages strictly inside the buffer are dropped. The
+//   allocator's chunk headers and any neighbouring allocation sharing the
+//   first or last page stay intact.
+// - Placement follows the default local NUMA policy: a page goes on the
+//   node of the thread that faults it in. A transparent huge page is split
+//   when only part of it is dropped.
+// When any of these do not hold (another allocator, an interleave policy,
+// no NUMA at all), the pages simply land where they would have anyway. The
+// results do not change; only the placement gain is lost.
+void releaseForFirstTouch(vector<float>& data) {
+    size_t bytes = data.size() * sizeof(float);
+    if (bytes < FIRST_TOUCH_MIN_BYTES) {
+        return;
+    }
+
+    // Only whole pages inside the buffer can be dropped.
+    uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+    uintptr_t first = ((uintptr_t)data.data() + pageSize - 1) & ~(pageSize - 1);
+    uintptr_t last = ((uintptr_t)data.data() + bytes) & ~(pageSize - 1);
+    if (last > first) {
+        madvise((void*)first, last - first, MADV_DONTNEED);
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <vector>
+#include <string>
+#include <queue>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <pthread.h>
+
+// Fixed set of worker threads that live for the whole program. Filters hand
+// work to the pool through parallelFor, so each call only costs a queue push
+// per worker instead of a pthread_create/pthread_join pair per segment.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t numThreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    // Threads a parallelFor issued from the current thread may use: the
+    // pool size, or the current StageScope's cap if that is smaller.
+    size_t concurrency() const;
+
+    void submit(std::function<void()> task);
+
+    // Splits [begin, end) into chunks of `grain` indices (or one chunk per
+    // worker when grain is 0) and calls body(chunkStart, chunkEnd) for each.
+    // The calling thread takes chunks as well and returns once all are done.
+    // Inside a StageScope with a thread cap, at most that many threads
+    // (caller included) take part.
+    void parallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t)>& body, size_t grain = 0);
+
+private:
+    static void* workerLoop(void* arg);
+
+    std::vector<pthread_t> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    bool stopping;
+};
+
+// Thread count used when the global pool is first created: the value passed to
+// setThreadCount, else the FILTER_THREADS environment variable, else
+// std::thread::hardware_concurrency().
+size_t defaultThreadCount();
+void setThreadCount(size_t numThreads);
+ThreadPool& globalPool();
+
+// Pins every worker to its own CPU from the process's affinity mask, in
+// mask order, and the thread that creates the pool to the first one, so
+// segments stay on one core's caches and consecutive workers fill one
+// socket before the next. Takes effect when the pool is (re)created; the
+// FILTER_PIN=1 environment variable turns it on as well.
+void setThreadPinning(bool enabled);
+
+// Per-stage thread caps, e.g. "fir=4,iir=2" from --stage-threads or the
+// FILTER_STAGE_THREADS environment variable. Stages without a cap use the
+// whole pool.
+void setStageThreads(const std::string& spec);
+
+// Marks the current thread as running `stage` until the scope ends, so its
+// parallelFor calls obey that stage's cap. The cap travels with each call's
+// chunks, so parallelFor calls nested inside them obey it too, whichever
+// worker runs them. Stage names: read, write, normalize, bandpass, notch, fir, iir, fused.
+class StageScope {
+public:
+    explicit StageScope(const char* stage);
+    ~StageScope();
+
+private:
+    size_t previousLimit;
+};
+
+// Drops the pages behind data[0, size) so that the next write to each page
+// allocates it on the writing thread's NUMA node (first touch) instead of
+// the node of the thread that zero-filled the vector. Only for buffers
+// whose contents are about to be overwritten or are still all zeros; the
+// contents read back as zeros. Small buffers are left alone.
+void releaseForFirstTouch(std::vector<float>& data);
+
+#endif
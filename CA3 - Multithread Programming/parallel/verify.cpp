@@ -0,0 +1,79 @@
+#include "verify.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+void referenceNormalize(vector<float>& data) {
+    float maxAmplitude = *max_element(data.begin(), data.end(), [](float a, float b) { return abs(a) < abs(b); });
+    if (maxAmplitude > 0) {
+        for (auto& sample : data) {
+            sample /= maxAmplitude;
+        }
+    }
+}
+
+void referenceFIRFilter(vector<float>& data, const vector<float>& coefficients) {
+    size_t M = coefficients.size();
+    vector<float> filteredData(data.size(), 0.0f);
+
+    for (size_t n = 0; n < data.size(); ++n) {
+        for (size_t k = 0; k < M; ++k) {
+            if (n >= k) {
+                filteredData[n] += coefficients[k] * data[n - k];
+            }
+        }
+    }
+
+    data = filteredData;
+}
+
+void referenceIIRFilter(vector<float>& data, const vector<float>& b, const vector<float>& a) {
+    size_t P = b.size();
+    size_t Q = a.size();
+    vector<float> filteredData(data.size(), 0.0f);
+
+    for (size_t n = 0; n < data.size(); ++n) {
+        for (size_t i = 0; i < P; ++i) {
+            if (n >= i) {
+                filteredData[n] += b[i] * data[n - i];
+            }
+        }
+        for (size_t j = 1; j < Q; ++j) {
+            if (n >= j) {
+                filteredData[n] -= a[j] * filteredData[n - j];
+            }
+        }
+    }
+
+    data = filteredData;
+}
+
+float maxAbsDifference(const vector<float>& x, const vector<float>& y) {
+    if (x.size() != y.size()) {
+        return INFINITY;
+    }
+
+    float maxDiff = 0.0f;
+    for (size_t i = 0; i < x.size(); ++i) {
+        maxDiff = max(maxDiff, std::abs(x[i] - y[i]));
+    }
+    return maxDiff;
+}
+
+void reportDifference(const string& name, const vector<float>& parallel, const vector<float>& serial, float tolerance) {
+    float diff = maxAbsDifference(parallel, serial);
+    cout << "Verify " << name << ": max abs difference " << diff << (diff <= tolerance ? " (ok)" : " (MISMATCH)") << endl;
+}
+
+void reportFilesIdentical(const string& name, const string& file, const string& reference) {
+    ifstream first(file, ios::binary);
+    ifstream second(reference, ios::binary);
+    vector<char> x((istreambuf_iterator<char>(first)), istreambuf_iterator<char>());
+    vector<char> y((istreambuf_iterator<char>(second)), istreambuf_iterator<char>());
+    cout << "Verify " << name << ": " << (x == y ? "byte-identical to sf_writef_float (ok)" : "differs from sf_writef_float (MISMATCH)") << endl;
+}
@@ -0,0 +1,19 @@
+#ifndef VERIFY_HPP
+#define VERIFY_HPP
+
+#include <vector>
+#include <string>
+
+// Straight ports of the filters in ../serial/main.cpp, used by --verify to
+// check the parallel kernels against the serial build's output.
+void referenceNormalize(std::vector<float>& data);
+void referenceFIRFilter(std::vector<float>& data, const std::vector<float>& coefficients);
+void referenceIIRFilter(std::vector<float>& data, const std::vector<float>& b, const std::vector<float>& a);
+
+float maxAbsDifference(const std::vector<float>& x, const std::vector<float>& y);
+void reportDifference(const std::string& name, const std::vector<float>& parallel, const std::vector<float>& serial, float tolerance);
+
+// Byte-for-byte comparison of two files.
+void reportFilesIdentical(const std::string& name, const std::string& file, const std::string& reference);
+
+#endif
@@ -0,0 +1,364 @@
+#include "wav_io.hpp"
+#include "thread_pool.hpp"
+#include "memory.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+const uint16_t WAVE_FORMAT_PCM = 0x0001;
+const uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+uint16_t readLE16(const unsigned char* p) {
+    return p[0] | (p[1] << 8);
+}
+
+uint32_t readLE32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Conversions use the same scale factors as libsndfile's normalised float
+// reads, so both paths give identical samples.
+void convertInt16Scalar(const unsigned char* in, float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        int16_t value;
+        memcpy(&value, in + 2 * i, 2);
+        out[i] = value * (1.0f / 0x8000);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+void convertInt16AVX2(const unsigned char* in, float* out, size_t count) {
+    const __m256 scale = _mm256_set1_ps(1.0f / 0x8000);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i packed = _mm_loadu_si128((const __m128i*)(in + 2 * i));
+        __m256 values = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(packed));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(values, scale));
+    }
+    convertInt16Scalar(in + 2 * i, out + i, count - i);
+}
+#endif
+
+void convertInt24(const unsigned char* in, float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const unsigned char* p = in + 3 * i;
+        int32_t value = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24);
+        out[i] = value * (1.0f / 0x80000000);
+    }
+}
+
+void convertInt32(const unsigned char* in, float* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        int32_t value;
+        memcpy(&value, in + 4 * i, 4);
+        out[i] = value * (1.0f / 0x80000000);
+    }
+}
+
+void convertFloat32(const unsigned char* in, float* out, size_t count) {
+    memcpy(out, in, count * sizeof(float));
+}
+
+typedef void (*SampleConverter)(const unsigned char* in, float* out, size_t count);
+
+SampleConverter selectInt16Converter() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return convertInt16AVX2;
+    }
+#endif
+    return convertInt16Scalar;
+}
+
+// Inverse of the read conversions, again following libsndfile: scale,
+// round with lrintf, and keep the low bytes (no clipping, as with
+// libsndfile's default SFC_SET_CLIPPING off).
+void encodeInt16(const float* in, unsigned char* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        int16_t value = (int16_t)lrintf(in[i] * (float)0x7FFF);
+        memcpy(out + 2 * i, &value, 2);
+    }
+}
+
+void encodeInt24(const float* in, unsigned char* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        int32_t value = (int32_t)lrintf(in[i] * (float)0x7FFFFFFF);
+        out[3 * i] = value >> 8;
+        out[3 * i + 1] = value >> 16;
+        out[3 * i + 2] = value >> 24;
+    }
+}
+
+void encodeInt32(const float* in, unsigned char* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        int32_t value = (int32_t)lrintf(in[i] * (float)0x7FFFFFFF);
+        memcpy(out + 4 * i, &value, 4);
+    }
+}
+
+typedef void (*SampleEncoder)(const float* in, unsigned char* out, size_t count);
+
+void writeLE16(unsigned char* p, uint16_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+void writeLE32(unsigned char* p, uint32_t value) {
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+void pwriteFully(int fd, const unsigned char* buffer, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t written = pwrite(fd, buffer, size, offset);
+        if (written <= 0) {
+            perror("pwrite");
+            exit(1);
+        }
+        buffer += written;
+        size -= written;
+        offset += written;
+    }
+}
+
+void readWavFileWithSndfile(const string& inputFile, vector<float>& data, SF_INFO& fileInfo) {
+    SNDFILE* inFile = sf_open(inputFile.c_str(), SFM_READ, &fileInfo);
+    if (!inFile) {
+        std::cerr << "Error opening input file: " << sf_strerror(NULL) << std::endl;
+        exit(1);
+    }
+
+    data.resize(fileInfo.frames * fileInfo.channels);
+    sf_count_t numFrames = sf_readf_float(inFile, data.data(), fileInfo.frames);
+    if (numFrames != fileInfo.frames) {
+        std::cerr << "Error reading frames from file." << std::endl;
+        sf_close(inFile);
+        exit(1);
+    }
+
+    sf_close(inFile);
+}
+
+}
+
+bool readPcmWavMapped(const string& inputFile, vector<float>& data, SF_INFO& fileInfo) {
+    int fd = open(inputFile.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || st.st_size < 12) {
+        close(fd);
+        return false;
+    }
+    size_t fileSize = st.st_size;
+
+    void* mapping = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    const unsigned char* bytes = (const unsigned char*)mapping;
+
+    if (memcmp(bytes, "RIFF", 4) != 0 || memcmp(bytes + 8, "WAVE", 4) != 0) {
+        munmap(mapping, fileSize);
+        return false;
+    }
+
+    // Walk the chunks once for "fmt " and "data".
+    uint16_t formatTag = 0;
+    uint16_t channels = 0;
+    uint32_t sampleRate = 0;
+    uint16_t bitsPerSample = 0;
+    const unsigned char* samples = NULL;
+    size_t dataSize = 0;
+    size_t offset = 12;
+    while (offset + 8 <= fileSize) {
+        const unsigned char* chunk = bytes + offset;
+        size_t chunkSize = readLE32(chunk + 4);
+        size_t body = offset + 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && body + chunkSize <= fileSize) {
+            formatTag = readLE16(bytes + body);
+            channels = readLE16(bytes + body + 2);
+            sampleRate = readLE32(bytes + body + 4);
+            bitsPerSample = readLE16(bytes + body + 14);
+            if (formatTag == WAVE_FORMAT_EXTENSIBLE && chunkSize >= 26) {
+                formatTag = readLE16(bytes + body + 24);
+            }
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            samples = bytes + body;
+            // Writers that could not seek back leave the size as 0 or
+            // 0xFFFFFFFF; the data then runs to the end of the file.
+            dataSize = (chunkSize == 0 || body + chunkSize > fileSize) ? fileSize - body : chunkSize;
+            break;
+        }
+        offset = body + chunkSize + (chunkSize & 1);
+    }
+
+    SampleConverter convert = NULL;
+    int subformat = 0;
+    if (formatTag == WAVE_FORMAT_PCM && bitsPerSample == 16) {
+        convert = selectInt16Converter();
+        subformat = SF_FORMAT_PCM_16;
+    } else if (formatTag == WAVE_FORMAT_PCM && bitsPerSample == 24) {
+        convert = convertInt24;
+        subformat = SF_FORMAT_PCM_24;
+    } else if (formatTag == WAVE_FORMAT_PCM && bitsPerSample == 32) {
+        convert = convertInt32;
+        subformat = SF_FORMAT_PCM_32;
+    } else if (formatTag == WAVE_FORMAT_IEEE_FLOAT && bitsPerSample == 32) {
+        convert = convertFloat32;
+        subformat = SF_FORMAT_FLOAT;
+    }
+
+    if (samples == NULL || convert == NULL || channels == 0) {
+        munmap(mapping, fileSize);
+        return false;
+    }
+
+    size_t bytesPerSample = bitsPerSample / 8;
+    size_t frames = dataSize / (bytesPerSample * channels);
+    size_t count = frames * channels;
+
+    memset(&fileInfo, 0, sizeof(fileInfo));
+    fileInfo.frames = frames;
+    fileInfo.samplerate = sampleRate;
+    fileInfo.channels = channels;
+    fileInfo.format = SF_FORMAT_WAV | subformat;
+    fileInfo.sections = 1;
+    fileInfo.seekable = 1;
+
+    // Each worker faults in and converts its own part of the mapping, and
+    // first-touches its part of `data`.
+    data.resize(count);
+    releaseForFirstTouch(data);
+    globalPool().parallelFor(0, count, [&](size_t start, size_t end) {
+        convert(samples + start * bytesPerSample, data.data() + start, end - start);
+    }, 1 << 16);
+
+    munmap(mapping, fileSize);
+    return true;
+}
+
+void readWavFile(const string& inputFile, vector<float>& data, SF_INFO& fileInfo) {
+    StageScope stage("read");
+    if (!readPcmWavMapped(inputFile, data, fileInfo)) {
+        readWavFileWithSndfile(inputFile, data, fileInfo);
+    }
+}
+
+void writeWavFileSequential(const string& outputFile, const vector<float>& data, SF_INFO& fileInfo) {
+    sf_count_t frames = data.size() / fileInfo.channels;
+    SNDFILE* outFile = sf_open(outputFile.c_str(), SFM_WRITE, &fileInfo);
+    if (!outFile) {
+        std::cerr << "Error opening output file: " << sf_strerror(NULL) << std::endl;
+        exit(1);
+    }
+
+    if (sf_writef_float(outFile, data.data(), frames) != frames) {
+        std::cerr << "Error writing frames to file." << std::endl;
+        sf_close(outFile);
+        exit(1);
+    }
+
+    sf_close(outFile);
+}
+
+void writeWavFile(const string& outputFile, const vector<float>& data, SF_INFO& fileInfo) {
+    StageScope stage("write");
+    SampleEncoder encode = NULL;
+    size_t bytesPerSample = 0;
+    if ((fileInfo.format & SF_FORMAT_TYPEMASK) == SF_FORMAT_WAV) {
+        switch (fileInfo.format & SF_FORMAT_SUBMASK) {
+        case SF_FORMAT_PCM_16:
+            encode = encodeInt16;
+            bytesPerSample = 2;
+            break;
+        case SF_FORMAT_PCM_24:
+            encode = encodeInt24;
+            bytesPerSample = 3;
+            break;
+        case SF_FORMAT_PCM_32:
+            encode = encodeInt32;
+            bytesPerSample = 4;
+            break;
+        }
+    }
+
+    if (encode == NULL) {
+        writeWavFileSequential(outputFile, data, fileInfo);
+        return;
+    }
+
+    int channels = fileInfo.channels;
+    size_t count = (data.size() / channels) * channels;
+    size_t dataSize = count * bytesPerSample;
+    size_t padding = dataSize & 1;
+
+    // Canonical 44-byte header: the same RIFF/fmt/data layout libsndfile
+    // writes for plain PCM WAV.
+    const size_t headerSize = 44;
+    unsigned char header[headerSize];
+    memcpy(header, "RIFF", 4);
+    writeLE32(header + 4, 36 + dataSize + padding);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    writeLE32(header + 16, 16);
+    writeLE16(header + 20, WAVE_FORMAT_PCM);
+    writeLE16(header + 22, channels);
+    writeLE32(header + 24, fileInfo.samplerate);
+    writeLE32(header + 28, fileInfo.samplerate * channels * bytesPerSample);
+    writeLE16(header + 32, channels * bytesPerSample);
+    writeLE16(header + 34, bytesPerSample * 8);
+    memcpy(header + 36, "data", 4);
+    writeLE32(header + 40, dataSize);
+
+    int fd = open(outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror("open");
+        std::cerr << "Error opening output file: " << outputFile << std::endl;
+        exit(1);
+    }
+
+    size_t fileSize = headerSize + dataSize + padding;
+    if (posix_fallocate(fd, 0, fileSize) != 0 && ftruncate(fd, fileSize) == -1) {
+        perror("ftruncate");
+        exit(1);
+    }
+    pwriteFully(fd, header, headerSize, 0);
+    if (padding) {
+        unsigned char zero = 0;
+        pwriteFully(fd, &zero, 1, headerSize + dataSize);
+    }
+
+    globalPool().parallelFor(0, count, [&](size_t start, size_t end) {
+        vector<unsigned char>& encoded = threadScratch().bytes;
+        encoded.resize((end - start) * bytesPerSample);
+        encode(data.data() + start, encoded.data(), end - start);
+        pwriteFully(fd, encoded.data(), encoded.size(), headerSize + start * bytesPerSample);
+    }, 1 << 16);
+
+    close(fd);
+    fileInfo.frames = count / channels;
+}
@@ -0,0 +1,27 @@
+#ifndef WAV_IO_HPP
+#define WAV_IO_HPP
+
+#include <vector>
+#include <string>
+#include <sndfile.h>
+
+// Decodes a whole file into interleaved floats. Little-endian PCM WAV
+// (16/24/32-bit integer or 32-bit float) is memory-mapped and converted by
+// the thread pool; anything else goes through libsndfile in one pass.
+void readWavFile(const std::string& inputFile, std::vector<float>& data, SF_INFO& fileInfo);
+
+// Memory-mapped fast path of readWavFile. Returns false, leaving `data`
+// untouched, when the file is not a WAV layout it understands.
+bool readPcmWavMapped(const std::string& inputFile, std::vector<float>& data, SF_INFO& fileInfo);
+
+// Encodes interleaved floats to a file in fileInfo's format. For WAV with
+// 16/24/32-bit PCM the header is written once, the file is preallocated
+// and workers convert and pwrite disjoint ranges of the data chunk; other
+// formats go through libsndfile sequentially. The bytes match what a
+// single sf_writef_float call produces.
+void writeWavFile(const std::string& outputFile, const std::vector<float>& data, SF_INFO& fileInfo);
+
+// One sf_writef_float over the whole buffer, as in the serial build.
+void writeWavFileSequential(const std::string& outputFile, const std::vector<float>& data, SF_INFO& fileInfo);
+
+#endif
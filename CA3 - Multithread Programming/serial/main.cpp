@@ -6,6 +6,12 @@
 #include <cmath>
 #include <algorithm>
 #include <chrono>
+#include <functional>
+#include <cctype>
+#include "../common/fft.hpp"
+#include "../common/stream.hpp"
+#include "../common/channels.hpp"
+#include "../common/design.hpp"
 
 using namespace std;
 using namespace std::chrono;
@@ -68,18 +74,99 @@ void applyBandpassFilter(std::vector<float>& data, int sampleRate, float lowCuto
     }
 }
 
+// With the order fixed at compile time the response is a few multiplies
+// instead of a std::pow per sample, and DC gets its limit of zero without
+// dividing by zero.
+template <int N>
+void applyNotchKernel(std::vector<float>& data, int sampleRate, float notchFrequency) {
+    for (size_t i = 0; i < data.size(); ++i) {
+        float f = static_cast<float>(i) / data.size() * sampleRate;
+        data[i] *= notchResponseOrder<N>(f, notchFrequency);
+    }
+}
+
 void applyNotchFilter(std::vector<float>& data, int sampleRate, float notchFrequency, int n) {
+    switch (n) {
+    case 1:
+        applyNotchKernel<1>(data, sampleRate, notchFrequency);
+        return;
+    case 2:
+        applyNotchKernel<2>(data, sampleRate, notchFrequency);
+        return;
+    case 3:
+        applyNotchKernel<3>(data, sampleRate, notchFrequency);
+        return;
+    case 4:
+        applyNotchKernel<4>(data, sampleRate, notchFrequency);
+        return;
+    }
+
     for (size_t i = 0; i < data.size(); ++i) {
         float f = static_cast<float>(i) / data.size() * sampleRate;
-        float H_f = 1.0f / (1.0f + std::pow((notchFrequency / f), 2 * n));
-        data[i] *= H_f;
+        data[i] *= notchResponse(f, notchFrequency, n);
+    }
+}
+
+// Direct FIR with the tap count fixed at compile time. Past the first M-1
+// samples the bounds test drops out and the tap loop unrolls; the sum is
+// accumulated in the same order as the generic loop, so results match it.
+template <int M>
+void applyFIRFilterFixed(const std::vector<float>& data, const std::vector<float>& coefficients, std::vector<float>& filteredData) {
+    float c[M];
+    for (int k = 0; k < M; ++k) {
+        c[k] = coefficients[k];
+    }
+
+    size_t head = std::min(data.size(), static_cast<size_t>(M - 1));
+    for (size_t n = 0; n < head; ++n) {
+        for (size_t k = 0; k <= n; ++k) {
+            filteredData[n] += c[k] * data[n - k];
+        }
+    }
+    for (size_t n = head; n < data.size(); ++n) {
+        float sum = 0.0f;
+        for (int k = 0; k < M; ++k) {
+            sum += c[k] * data[n - k];
+        }
+        filteredData[n] = sum;
     }
 }
 
 void applyFIRFilter(std::vector<float>& data, const std::vector<float>& coefficients) {
+    if (coefficients.size() >= FFT_CONVOLUTION_MIN_TAPS) {
+        OverlapSaveConvolver convolver(coefficients);
+        std::vector<float> filteredData(data.size());
+        std::vector<std::complex<float>> scratch;
+        for (size_t start = 0; start < data.size(); start += convolver.blockSize()) {
+            size_t end = std::min(data.size(), start + convolver.blockSize());
+            convolver.convolveBlock(data, start, end, filteredData.data(), scratch);
+        }
+        data = filteredData;
+        return;
+    }
+
     int M = coefficients.size();
     std::vector<float> filteredData(data.size(), 0.0f);
 
+    switch (M) {
+    case 3:
+        applyFIRFilterFixed<3>(data, coefficients, filteredData);
+        data = filteredData;
+        return;
+    case 5:
+        applyFIRFilterFixed<5>(data, coefficients, filteredData);
+        data = filteredData;
+        return;
+    case 7:
+        applyFIRFilterFixed<7>(data, coefficients, filteredData);
+        data = filteredData;
+        return;
+    case 9:
+        applyFIRFilterFixed<9>(data, coefficients, filteredData);
+        data = filteredData;
+        return;
+    }
+
     for (size_t n = 0; n < data.size(); ++n) {
         for (int k = 0; k < M; ++k) {
             if (n >= k) {
@@ -112,21 +199,211 @@ void applyIIRFilter(std::vector<float>& data, const std::vector<float>& b, const
     data = filteredData;
 }
 
+// One output of the filter graph: a copy of the decoded input, optionally
+// normalised, run through `apply` once per channel and written to
+// `outputFile`.
+struct FilterBranch {
+    std::string name;
+    std::string outputFile;
+    bool normalize;
+    std::function<void(std::vector<float>&)> apply;
+    long long filterUs = 0;
+    long long writeUs = 0;
+};
+
+// Runs every branch on the same decoded input, so the file is read once
+// instead of once per filter.
+void runFilterGraph(const std::vector<float>& input, const SF_INFO& fileInfo, std::vector<FilterBranch>& branches) {
+    std::vector<float> data;
+    PlanarAudio planar;
+    for (FilterBranch& branch : branches) {
+        data = input;
+        if (branch.normalize) {
+            normalizeAudio(data);
+        }
+
+        auto startFilter = high_resolution_clock::now();
+        if (fileInfo.channels > 1) {
+            deinterleave(data, fileInfo.channels, planar);
+            for (std::vector<float>& channel : planar) {
+                branch.apply(channel);
+            }
+            interleave(planar, data);
+        } else {
+            branch.apply(data);
+        }
+        auto endFilter = high_resolution_clock::now();
+
+        SF_INFO outInfo = fileInfo;
+        writeWavFile(branch.outputFile, data, outInfo);
+        auto endWrite = high_resolution_clock::now();
+
+        branch.filterUs = duration_cast<microseconds>(endFilter - startFilter).count();
+        branch.writeUs = duration_cast<microseconds>(endWrite - endFilter).count();
+    }
+}
+
+// Streaming forms of applyBandpassFilter and applyNotchFilter. Their
+// response depends on the sample's position in the whole file, so the
+// stages count samples across blocks.
+class BandpassStage : public FilterStage {
+public:
+    BandpassStage(int sampleRate, float lowCutoff, float highCutoff, size_t totalSamples)
+        : sampleRate(sampleRate), lowCutoff(lowCutoff), highCutoff(highCutoff), totalSamples(totalSamples), position(0) {}
+
+    void process(const std::vector<float>& input, std::vector<float>& output) override {
+        float deltaF = highCutoff - lowCutoff;
+        for (float sample : input) {
+            float f = static_cast<float>(position++) / totalSamples * sampleRate;
+            if (f < lowCutoff || f > highCutoff) {
+                output.push_back(0.0f);
+            } else {
+                output.push_back(sample * ((f * f) / (f * f + deltaF * deltaF)));
+            }
+        }
+    }
+
+private:
+    int sampleRate;
+    float lowCutoff;
+    float highCutoff;
+    size_t totalSamples;
+    size_t position;
+};
+
+class NotchStage : public FilterStage {
+public:
+    NotchStage(int sampleRate, float notchFrequency, int n, size_t totalSamples)
+        : sampleRate(sampleRate), notchFrequency(notchFrequency), n(n), totalSamples(totalSamples), position(0) {}
+
+    void process(const std::vector<float>& input, std::vector<float>& output) override {
+        for (float sample : input) {
+            float f = static_cast<float>(position++) / totalSamples * sampleRate;
+            output.push_back(sample * notchResponse(f, notchFrequency, n));
+        }
+    }
+
+private:
+    int sampleRate;
+    float notchFrequency;
+    int n;
+    size_t totalSamples;
+    size_t position;
+};
+
+// Lowercase branch name without punctuation ("Band-pass" -> "bandpass"),
+// as used by --filter and the --timings lines.
+std::string branchKey(const std::string& name) {
+    std::string key;
+    for (char c : name) {
+        if (isalnum(static_cast<unsigned char>(c))) {
+            key += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        }
+    }
+    return key;
+}
+
+// Keeps only the branch selected with --filter, so one filter can be timed
+// on its own.
+void selectBranch(std::vector<FilterBranch>& branches, const std::string& key) {
+    std::vector<FilterBranch> selected;
+    for (FilterBranch& branch : branches) {
+        if (branchKey(branch.name) == key) {
+            selected.push_back(std::move(branch));
+        }
+    }
+    if (selected.empty()) {
+        std::cerr << "Error: unknown filter '" << key << "'" << std::endl;
+        exit(1);
+    }
+    branches.swap(selected);
+}
+
+// Machine-readable form of the timing report (microseconds), one
+// "timing <what> <us>" line each, for the benchmark harness.
+void printTimings(const std::vector<FilterBranch>& branches, long long readUs, long long writeUs, long long totalUs) {
+    cout << "timing read " << readUs << endl;
+    cout << "timing write " << writeUs << endl;
+    for (const FilterBranch& branch : branches) {
+        cout << "timing " << branchKey(branch.name) << " " << branch.filterUs << endl;
+    }
+    cout << "timing total " << totalUs << endl;
+}
+
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <../input.wav>" << std::endl;
+    std::string inputFile;
+    bool stream = false;
+    bool timings = false;
+    std::string filterKey;
+    size_t blockFrames = STREAM_BLOCK_FRAMES;
+    size_t firTaps = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--stream") {
+            stream = true;
+        } else if (arg == "--timings") {
+            timings = true;
+        } else if (arg == "--filter" && i + 1 < argc) {
+            filterKey = argv[++i];
+        } else if (arg == "--block-frames" && i + 1 < argc) {
+            blockFrames = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--fir-taps" && i + 1 < argc) {
+            firTaps = std::max(1, atoi(argv[++i]));
+        } else {
+            inputFile = arg;
+        }
+    }
+
+    if (inputFile.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--stream] [--block-frames N] [--fir-taps N] [--filter bandpass|notch|fir|iir] [--timings] <../input.wav>" << std::endl;
         return 1;
     }
 
     auto start = high_resolution_clock::now();
 
+    // --fir-taps swaps the 5-tap FIR for a long low-pass, which takes the
+    // FFT overlap-save path.
+    std::vector<float> firCoefficients = {0.1, 0.15, 0.5, 0.15, 0.1};
+    if (firTaps > 0) {
+        firCoefficients = windowedSincLowpass(firTaps, 0.1f);
+    }
 
-    std::string inputFile = argv[1];
     std::string outputFile1 = "outputBandpassSerial.wav";
     std::string outputFile2 = "outputNotchSerial.wav";
     std::string outputFile3 = "outputFIRSerial.wav";
     std::string outputFile4 = "outputIIRSerial.wav";
 
+    if (stream) {
+        SF_INFO streamInfo = readStreamInfo(inputFile);
+        // Each channel is its own signal, so the position-based stages count frames.
+        size_t totalSamples = streamInfo.frames;
+        int sampleRate = streamInfo.samplerate;
+        int channels = streamInfo.channels;
+        float peak = streamPeakSample(inputFile, blockFrames);
+
+        std::vector<FilterChain> chains(4);
+        addPerChannel(chains[0], channels, [=](FilterChain& chain) {
+            chain.add(new NormalizeStage(peak));
+            chain.add(new BandpassStage(sampleRate, 300.0f, 3000.0f, totalSamples));
+        });
+        addPerChannel(chains[1], channels, [=](FilterChain& chain) {
+            chain.add(new NotchStage(sampleRate, 50.0f, 2, totalSamples));
+        });
+        addPerChannel(chains[2], channels, [&](FilterChain& chain) {
+            chain.add(new FIRStage(firCoefficients));
+        });
+        addPerChannel(chains[3], channels, [](FilterChain& chain) {
+            chain.add(new IIRStage({0.1, 0.15, 0.5, 0.15, 0.1}, {1.0, -0.5, 0.25}));
+        });
+
+        streamFilterChains(inputFile, chains, {outputFile1, outputFile2, outputFile3, outputFile4}, blockFrames);
+
+        auto end = high_resolution_clock::now();
+        cout << "Streamed all filters in blocks of " << blockFrames << " frames: "
+             << duration_cast<milliseconds>(end - start).count() << " ms" << endl;
+        return 0;
+    }
+
     SF_INFO fileInfo;
     std::vector<float> audioData;
     std::memset(&fileInfo, 0, sizeof(fileInfo));
@@ -135,57 +412,40 @@ int main(int argc, char* argv[]) {
     readWavFile(inputFile, audioData, fileInfo);
     auto endRead = high_resolution_clock::now();
 
-    normalizeAudio(audioData);
-
-    auto startBandpass = high_resolution_clock::now();
-    applyBandpassFilter(audioData, fileInfo.samplerate, 300.0f, 3000.0f);
-    auto endBandpass = high_resolution_clock::now();
-
-    auto startWrite = high_resolution_clock::now();
-    writeWavFile(outputFile1, audioData, fileInfo);
-    auto endWrite = high_resolution_clock::now();
-   
-    readWavFile(inputFile, audioData, fileInfo);
-
-    auto startNotch = high_resolution_clock::now();
-    applyNotchFilter(audioData, fileInfo.samplerate, 50.0f, 2);
-    auto endNotch = high_resolution_clock::now();
-    writeWavFile(outputFile2, audioData, fileInfo);
-
-    readWavFile(inputFile, audioData, fileInfo);
-
-    std::vector<float> firCoefficients = {0.1, 0.15, 0.5, 0.15, 0.1};
-    auto startFIR = high_resolution_clock::now();
-    applyFIRFilter(audioData, firCoefficients);
-    auto endFIR = high_resolution_clock::now();
-    writeWavFile(outputFile3, audioData, fileInfo);
-
-    readWavFile(inputFile, audioData, fileInfo);
-
+    int sampleRate = fileInfo.samplerate;
     std::vector<float> b = {0.1, 0.15, 0.5, 0.15, 0.1};
     std::vector<float> a = {1.0, -0.5, 0.25};
-    auto startIIR = high_resolution_clock::now();
-    applyIIRFilter(audioData, b, a);
-    auto endIIR = high_resolution_clock::now();
-    writeWavFile(outputFile4, audioData, fileInfo);
+
+    std::vector<FilterBranch> branches = {
+        {"Band-pass", outputFile1, true, [&](std::vector<float>& data) { applyBandpassFilter(data, sampleRate, 300.0f, 3000.0f); }},
+        {"Notch", outputFile2, false, [&](std::vector<float>& data) { applyNotchFilter(data, sampleRate, 50.0f, 2); }},
+        {"FIR", outputFile3, false, [&](std::vector<float>& data) { applyFIRFilter(data, firCoefficients); }},
+        {"IIR", outputFile4, false, [&](std::vector<float>& data) { applyIIRFilter(data, b, a); }},
+    };
+    if (!filterKey.empty()) {
+        selectBranch(branches, filterKey);
+    }
+
+    runFilterGraph(audioData, fileInfo, branches);
 
     auto end = high_resolution_clock::now();
 
-    auto durationRead = duration_cast<milliseconds>(endRead - startRead).count();
-    auto durationWrite = duration_cast<milliseconds>(endWrite - startWrite).count();
-    auto durationBandpass = duration_cast<milliseconds>(endBandpass - startBandpass).count();
-    auto durationNotch = duration_cast<milliseconds>(endNotch - startNotch).count();
-    auto durationFIR = duration_cast<milliseconds>(endFIR - startFIR).count();
-    auto durationIIR = duration_cast<milliseconds>(endIIR - startIIR).count();
-    auto totalDuration = duration_cast<milliseconds>(end - start).count();
-
-    cout << "Time taken to read data: " << durationRead << " ms" << endl;
-    cout << "Time taken to write data: " << durationWrite << " ms" << endl;
-    cout << "Time taken to apply Band-pass Filter: " << durationBandpass << " ms" << endl;
-    cout << "Time taken to apply Notch Filter: " << durationNotch << " ms" << endl;
-    cout << "Time taken to apply FIR Filter: " << durationFIR << " ms" << endl;
-    cout << "Time taken to apply IIR Filter: " << durationIIR << " ms" << endl;
-    cout << "Total execution time: " << totalDuration << " ms" << endl;
+    auto durationRead = duration_cast<microseconds>(endRead - startRead).count();
+    auto totalDuration = duration_cast<microseconds>(end - start).count();
+    long long durationWrite = 0;
+    for (const FilterBranch& branch : branches) {
+        durationWrite += branch.writeUs;
+    }
+
+    if (timings) {
+        printTimings(branches, durationRead, durationWrite, totalDuration);
+    }
+    cout << "Time taken to read data: " << durationRead / 1000 << " ms" << endl;
+    cout << "Time taken to write data: " << durationWrite / 1000 << " ms (all outputs)" << endl;
+    for (const FilterBranch& branch : branches) {
+        cout << "Time taken to apply " << branch.name << " Filter: " << branch.filterUs / 1000 << " ms" << endl;
+    }
+    cout << "Total execution time: " << totalDuration / 1000 << " ms" << endl;
 
     return 0;
 }